@@ -5,6 +5,9 @@
  */ 
 
 #include "ledmatrix.h"
+#include "compositor.h"
+#include "occupancy.h"
+#include "flow_field.h"
 #include "pixel_colour.h"
 #include "game_position.h"
 #include "game_background.h"
@@ -21,19 +24,48 @@
 
 // Aliens occupy 2x2 pixels. We record the position of the bottom
 // left pixel of each alien (x,y). The alien will also occupy
-// (x,y+1), (x+1,y), (x+1,y+1). There can be up to MAX_ALIENS aliens - for each
-// alien from 0 up to num_aliens-1, we record the position of that
-// alien in the alien_position array. 
-
-static uint8_t num_aliens;
-static uint8_t alien_position[MAX_ALIENS];
+// (x,y+1), (x+1,y), (x+1,y+1). There can be up to MAX_ALIENS aliens. Each
+// alien keeps its number (its slot in the arrays below) for as long as it
+// is in the game - live_aliens has bit n set if alien n is in use, and
+// num_aliens is the number of bits set. The position of an unused alien
+// is INVALID_POSITION.
+#if MAX_ALIENS <= 8
+typedef uint8_t AlienSet;
+#elif MAX_ALIENS <= 16
+typedef uint16_t AlienSet;
+#else
+typedef uint32_t AlienSet;
+#endif
+#define ALIEN_BIT(alien_number)	((AlienSet)1 << (alien_number))
 
 // Each alien starts with a certain amount of "energy" - once this 
 // is depleted the alien is removed from the display. We keep track 
 // of the energy for each alien.
-static int8_t alien_energy[MAX_ALIENS];
 #define INITIAL_ALIEN_ENERGY 10
 
+static AlienSet live_aliens;
+static uint8_t num_aliens;
+static uint8_t alien_position[MAX_ALIENS];
+static int8_t alien_energy[MAX_ALIENS];
+
+// How far the aliens move each time move_aliens() is called (8.8 fixed
+// point, in positions - see alien.h), and how far they have got towards 
+// their next step. (The aliens all step together, so they share these.)
+static uint16_t alien_speed = ALIEN_SPEED(1);
+static uint8_t alien_fraction;
+
+// If alien_steering is set, aliens move towards the player (following the
+// flow field) instead of in random directions
+static uint8_t alien_steering;
+
+// Each time the aliens move, there is a 1 in ALIEN_FIRE_CHANCE chance of
+// a randomly chosen alien number firing (if there is an alien with that
+// number). The more aliens there are, the more they fire.
+#define ALIEN_FIRE_CHANCE 3
+
+// Possible move that can't be made (not a valid position)
+#define NO_MOVE		0xFE
+
 // Colours
 #define COLOUR_ALIEN		COLOUR_RED	
 #define COLOUR_ALIEN_HIT	COLOUR_LIGHT_ORANGE
@@ -42,10 +74,13 @@ static int8_t alien_energy[MAX_ALIENS];
 // These functions are defined after the public functions. Comments are with the
 // definitions. These functions are static, so not accessible outside this file.
 
+static void step_aliens(void);
+static uint16_t blocked_row(uint8_t y);
+static uint8_t steering_distance(uint8_t position);
+static void fire_from_random_alien(void);
 static uint8_t move_alien_left_if_possible(uint8_t alien_number);
-static uint8_t move_alien_down_if_possible(uint8_t alien_number);
-static uint8_t move_alien_up_if_possible(uint8_t alien_number);
 static void move_alien(uint8_t alien_number, uint8_t new_position);
+static void place_alien(uint8_t alien_number, uint8_t new_position);
 static void remove_alien(uint8_t alien_number);
 static void erase_alien(uint8_t alien_number);
 static void redraw_alien(uint8_t alien_number);
@@ -58,60 +93,145 @@ static void draw_alien_hit(uint8_t position);
 // Initialise alien data
 void init_aliens(void) {
 	num_aliens = 0;
+	live_aliens = 0;
+	alien_fraction = 0;
+	for(uint8_t i = 0; i < MAX_ALIENS; i++) {
+		alien_position[i] = INVALID_POSITION;
+	}
+	occupancy_remove_all(OCCUPANT_ALIEN);
+	compositor_clear_layer(LAYER_ALIENS);
+	compositor_clear_layer(LAYER_ALIEN_HITS);
+	compositor_set_layer_colour(LAYER_ALIENS, COLOUR_ALIEN);
+	compositor_set_layer_colour(LAYER_ALIEN_HITS, COLOUR_ALIEN_HIT);
 }
 
-void move_random_alien(void) {
-	if(num_aliens == 0) {
-		// No aliens - can't move any
-		return;
+void move_aliens(void) {
+	// Work out how many steps the aliens take this time
+	uint16_t travel = alien_fraction + alien_speed;
+	alien_fraction = travel & 0xFF;
+	for(uint8_t steps = travel >> 8; steps; steps--) {
+		step_aliens();
+	}
+	fire_from_random_alien();
+}
+
+void set_alien_speed(uint16_t speed) {
+	alien_speed = speed;
+}
+
+// Move each alien one position (if it can). See move_aliens().
+static void step_aliens(void) {
+	// The pixels that aliens can't move into. This starts off as the 
+	// background and the aliens in their current positions and is updated
+	// as each alien's move is decided, so that later aliens can't move into
+	// the same place, but can move into a place that an earlier alien has
+	// left.
+	uint16_t blocked[MATRIX_NUM_ROWS];
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		blocked[y] = blocked_row(y);
 	}
-	// Variable to keep track of the number of the alien that we've moved - set 
-	// to -1 initially to indicate that we haven't moved an alien.
-	int8_t alien_moved = -1;
 	
-	// Pick the alien that we'll start from. (If we can't move this one
-	// we'll move on to the next - and wrap around if necessary until
-	// we've tried them all.)
-	uint8_t random_initial_alien = rand()%num_aliens;
-	uint8_t alien_to_try = random_initial_alien;
-	do {
-		// Pick a random direction. 0 means left, 1 means up, 2 means down.
-		// If we can't move in this direction, we'll try the others
-		uint8_t random_direction = rand()%3;
+	// Decide on the moves. new_position is where each moving alien will go
+	// (INVALID_POSITION if it leaves the game field, NO_MOVE if it can't move).
+	uint8_t new_position[MAX_ALIENS];
+	AlienSet moving = 0;
+	AlienSet remaining = live_aliens;
+	for(uint8_t i = 0; remaining; i++, remaining >>= 1) {
+		if(!(remaining & 1)) {
+			continue;
+		}
+		uint8_t alienX = GET_X_POSITION(alien_position[i]);
+		uint8_t alienY = GET_Y_POSITION(alien_position[i]);
+		uint16_t alien_columns = (3U << alienX);
+		
+		// Work out where the alien could move to in each direction - 0 means
+		// left, 1 means up, 2 means down. (Moving left from the left most 
+		// column takes the alien off the game field.)
+		uint8_t options[3] = { NO_MOVE, NO_MOVE, NO_MOVE };
+		if(alienX == 0) {
+			options[0] = INVALID_POSITION;
+		} else if(!((blocked[alienY] | blocked[alienY + 1]) & (1U << (alienX - 1)))) {
+			options[0] = GAME_POSITION(alienX - 1, alienY);
+		}
+		if(alienY < 6 && !(blocked[alienY + 2] & alien_columns)) {
+			options[1] = GAME_POSITION(alienX, alienY + 1);
+		}
+		if(alienY > 0 && !(blocked[alienY - 1] & alien_columns)) {
+			options[2] = GAME_POSITION(alienX, alienY - 1);
+		}
+		
 		uint8_t move_made = 0;
-		for(uint8_t j = random_direction; j < 3 + random_direction; j++) {
-			switch(j%3) {
-				case 0:
-					move_made = move_alien_left_if_possible(alien_to_try);
-					break;
-				case 1:
-					move_made = move_alien_up_if_possible(alien_to_try);
-					break;
-				case 2:
-					move_made = move_alien_down_if_possible(alien_to_try);
-					break;
+		if(alien_steering) {
+			// Take the possible move that gets closest to the player (the
+			// first of these if there's a tie) - if any gets closer than
+			// the alien is now
+			uint8_t best_distance = steering_distance(alien_position[i]);
+			for(uint8_t j = 0; j < 3; j++) {
+				if(options[j] != NO_MOVE && steering_distance(options[j]) < best_distance) {
+					best_distance = steering_distance(options[j]);
+					new_position[i] = options[j];
+					move_made = 1;
+				}
 			}
-			if(move_made) {
-				// No need to try any other directions - break out of for loop
-				break;
+		}
+		if(!move_made) {
+			// Pick a random direction. If we can't move in this direction, 
+			// we'll try the others
+			uint8_t random_direction = rand()%3;
+			for(uint8_t j = random_direction; j < 3 + random_direction; j++) {
+				if(options[j%3] != NO_MOVE) {
+					new_position[i] = options[j%3];
+					move_made = 1;
+					break;
+				}
 			}
 		}
 		if(move_made) {
-			alien_moved = alien_to_try;
-			// No need to try any other aliens - break out of do-while loop
-			break;
+			moving |= ALIEN_BIT(i);
+			blocked[alienY] &= ~alien_columns;
+			blocked[alienY + 1] &= ~alien_columns;
+			if(new_position[i] != INVALID_POSITION) {
+				uint8_t newX = GET_X_POSITION(new_position[i]);
+				uint8_t newY = GET_Y_POSITION(new_position[i]);
+				blocked[newY] |= (3U << newX);
+				blocked[newY + 1] |= (3U << newX);
+			}
 		}
-		alien_to_try = (alien_to_try + 1) % num_aliens;
-		// Keep going while we haven't tried them all (we'll have broken out of here if
-		// we made a move)
-	} while(alien_to_try != random_initial_alien);
+	}
+	if(!moving) {
+		return;
+	}
 	
-	if(alien_moved != -1) {
-		// We have moved an alien - check whether it has collided with player
-		// (The move itself has already checked whether the alien collided 
-		// with a projectile.)
-		check_if_player_is_dead();
+	// Make the moves - first take all the moving aliens out of their old
+	// positions, then put them in their new ones
+	remaining = moving;
+	for(uint8_t i = 0; remaining; i++, remaining >>= 1) {
+		if(remaining & 1) {
+			if(new_position[i] == INVALID_POSITION) {
+				remove_alien(i);
+			} else {
+				erase_alien(i);
+			}
+		}
+	}
+	remaining = moving;
+	for(uint8_t i = 0; remaining; i++, remaining >>= 1) {
+		if((remaining & 1) && new_position[i] != INVALID_POSITION) {
+			place_alien(i, new_position[i]);
+		}
 	}
+	
+	// Check whether any alien has collided with the player. (Placing the aliens
+	// has already dealt with any projectiles they moved into.)
+	check_if_player_is_dead();
+}
+
+void set_alien_steering(uint8_t steering) {
+	alien_steering = steering;
+}
+
+uint8_t get_alien_steering(void) {
+	return alien_steering;
 }
 
 int8_t add_alien_to_game(void) {
@@ -119,41 +239,44 @@ int8_t add_alien_to_game(void) {
 		// Can't add any more - max number already on the display
 		return -1;
 	}
-	// The new alien number will be the current number of aliens.
-	uint8_t new_alien_number = num_aliens;
+	// The new alien number will be the first unused number
+	uint8_t new_alien_number = 0;
+	while(live_aliens & ALIEN_BIT(new_alien_number)) {
+		new_alien_number++;
+	}
 	
 	// Alien will be added on the right hand side - the left side of the
 	// 2-pixel wide alien will be in the third last column, and the right
 	// hand side will be in the second last column.
-	// We try row numbers (for the bottom row of the alien) from 
-	// 0 to 6 until we find a position where the alien can be inserted 
-	// without colliding with the background or another alien
-	uint8_t alienX = 13; // Third last column
-	for(uint8_t alienY = 0; alienY <= 6; alienY++) {
-		// Work out all the positions that would be occupied by the alien
-		// if it were placed at (alienX, alienY)
-		uint8_t bottom_left = GAME_POSITION(alienX, alienY);
-		uint8_t bottom_right = GAME_POSITION(alienX + 1, alienY);
-		uint8_t top_left = GAME_POSITION(alienX, alienY + 1);
-		uint8_t top_right = GAME_POSITION(alienX + 1, alienY + 1);
-		// Check whether any of these positions are occupied by background or 
-		// another alien. If not - add an alien
-		if(!is_background_at(bottom_left) && !is_background_at(bottom_right) &&
-				!is_background_at(top_left) && !is_background_at(top_right) &&
-				!is_alien_at(bottom_left) && !is_alien_at(bottom_right) &&
-				!is_alien_at(top_left) && !is_alien_at(top_right)) {
-			// Nothing at this position - we have found a position for our alien
-			// Initialise the alien details, display it, check whether
-			// it ended up on top of the player and return.
-			alien_position[new_alien_number] = bottom_left;
-			alien_energy[new_alien_number] = INITIAL_ALIEN_ENERGY;
-			num_aliens++;
-			redraw_alien(new_alien_number);
-			// Check whether it has collided with the player (which will redraw
-			// the player if so)
-			check_if_player_is_dead();
-			return new_alien_number;
+	// The background module keeps track of where there is room in these 
+	// columns (bit y is set if the alien could go in rows y and y+1). We
+	// take out any places with aliens (from the occupancy map) or 
+	// projectiles in the way and use the lowest place left.
+	uint8_t occupied = occupied_rows_in_column(ALIEN_SPAWN_X) |
+			occupied_rows_in_column(ALIEN_SPAWN_X + 1);
+	for(uint8_t y = 0; y <= 7; y++) {
+		uint16_t projectiles = compositor_get_row(LAYER_PROJECTILES, y) |
+				compositor_get_row(LAYER_ALIEN_PROJECTILES, y);
+		if(projectiles & (3U << ALIEN_SPAWN_X)) {
+			occupied |= (1 << y);
+		}
+	}
+	uint8_t free_spans = get_free_spawn_spans() & ~(occupied | (occupied >> 1));
+	if(free_spans) {
+		uint8_t alienY = 0;
+		while(!(free_spans & (1 << alienY))) {
+			alienY++;
 		}
+		// Initialise the alien details, display it, check whether
+		// it ended up on top of the player and return.
+		alien_position[new_alien_number] = GAME_POSITION(ALIEN_SPAWN_X, alienY);
+		alien_energy[new_alien_number] = INITIAL_ALIEN_ENERGY;
+		live_aliens |= ALIEN_BIT(new_alien_number);
+		num_aliens++;
+		redraw_alien(new_alien_number);
+		// Check whether it has collided with the player
+		check_if_player_is_dead();
+		return new_alien_number;
 	}
 	return -1; // We weren't able to add an alien
 }
@@ -161,30 +284,16 @@ int8_t add_alien_to_game(void) {
 // Returns the alien number if there is an alien at the given position,
 // otherwise it returns -1
 int8_t alien_at(uint8_t position) {
-	// Check each alien
-	for(uint8_t alien_num = 0; alien_num < num_aliens; alien_num++) {
-		// We need to check whether any pixel of the alien matches this position
-		// so we iterate over all the pixels
-		for(uint8_t deltaX = 0; deltaX <= 1; deltaX++) {
-			for(uint8_t deltaY = 0; deltaY <= 1; deltaY++) {
-				uint8_t position_to_check = neighbour_position(alien_position[alien_num], deltaX, deltaY);
-				if(position == position_to_check) {
-					// One of the pixels of this alien matches this position
-					return alien_num;
-				}
-			}
-		}
+	uint8_t occupant = occupant_at(position);
+	if(OCCUPANT_KIND(occupant) != OCCUPANT_ALIEN) {
+		return -1;
 	}
-	return -1;
+	return OCCUPANT_NUMBER(occupant);
 }
 
 // Return 1 if there is an alien at the given position, 0 otherwise
 uint8_t is_alien_at(uint8_t position) {
-	if(alien_at(position) == -1) {
-		return 0;
-	} else {
-		return 1;
-	}
+	return OCCUPANT_KIND(occupant_at(position)) == OCCUPANT_ALIEN;
 }
 
 // Indicate that the given alien has been hit by a projectile at the given position
@@ -203,8 +312,8 @@ void alien_hit_at(uint8_t alien_num, uint8_t projectile_position) {
 		}
 		
 	} else {
-		// alien still has energy - indicate the hit (which will be overwritten
-		// when the alien is redrawn, i.e. when it moves)
+		// alien still has energy - indicate the hit (which will be removed
+		// when the alien moves or the background scrolls)
 		draw_alien_hit(projectile_position);
 	}
 }
@@ -215,25 +324,67 @@ void check_aliens_prior_to_background_scroll(void) {
 	// Check if there is background to the immediate right of any alien, i.e.
 	// the background will scroll into the alien. If so, attempt to move the alien
 	// left. If this isn't possible, then remove the alien.
-	for(uint8_t i = 0; i < num_aliens; i++) {
+	AlienSet remaining = live_aliens;
+	for(uint8_t i = 0; remaining; i++, remaining >>= 1) {
+		if(!(remaining & 1)) {
+			continue;
+		}
 		uint8_t alienX = GET_X_POSITION(alien_position[i]);
 		uint8_t alienY = GET_Y_POSITION(alien_position[i]);
-		if(is_background_at(GAME_POSITION(alienX + 2, alienY)) ||
-				is_background_at(GAME_POSITION(alienX + 2, alienY + 1))) {
+		uint16_t background = compositor_get_row(LAYER_BACKGROUND, alienY) |
+				compositor_get_row(LAYER_BACKGROUND, alienY + 1);
+		if(background & (1U << (alienX + 2))) {
 			// Background will collide with this alien - try moving it left
 			if(!move_alien_left_if_possible(i)) {
 				// We couldn't move the alien left - remove it
 				remove_alien(i);
-				// Note - this will change the alien array so that if this alien
-				// wasn't the last alien, there will be a new alien in its place.
-				// We decrement i so we can check this alien number again.
-				i--;
 			}
 		}
 	}
 }
 
 
+// Return the flow field distance to the player for an alien at the given
+// position - the distance from the closest of its four pixels. An alien 
+// moving off the game field (INVALID_POSITION) is treated as far away.
+static uint8_t steering_distance(uint8_t position) {
+	if(position == INVALID_POSITION) {
+		return FLOW_FIELD_FAR;
+	}
+	uint8_t alienX = GET_X_POSITION(position);
+	uint8_t alienY = GET_Y_POSITION(position);
+	uint8_t closest = FLOW_FIELD_FAR;
+	for(uint8_t deltaX = 0; deltaX <= 1; deltaX++) {
+		for(uint8_t deltaY = 0; deltaY <= 1; deltaY++) {
+			uint8_t distance = flow_field_distance(GAME_POSITION(alienX + deltaX, alienY + deltaY));
+			if(distance < closest) {
+				closest = distance;
+			}
+		}
+	}
+	return closest;
+}
+
+// Maybe fire a projectile from an alien (see ALIEN_FIRE_CHANCE). The
+// projectile starts to the left of the alien, in its top or bottom row.
+static void fire_from_random_alien(void) {
+	uint16_t random = rand();
+	uint8_t alien_number = random % MAX_ALIENS;
+	random /= MAX_ALIENS;
+	if(random % ALIEN_FIRE_CHANCE != 0 || !(live_aliens & ALIEN_BIT(alien_number))) {
+		return;
+	}
+	random /= ALIEN_FIRE_CHANCE;
+	fire_alien_projectile(neighbour_position(alien_position[alien_number], -1, random & 1));
+}
+
+// Return the pixels of row y that an alien can't move into - those with
+// background or (part of) another alien. Bit x is pixel (x,y).
+static uint16_t blocked_row(uint8_t y) {
+	return compositor_get_row(LAYER_BACKGROUND, y) | 
+			compositor_get_row(LAYER_ALIENS, y);
+}
+
 // Attempt to move the alien left if possible - returns 1 if it is possible.
 // Returns 0 if another alien is in the way OR there is background in the way
 // If the alien is in the left most column then the alien is removed.
@@ -247,40 +398,9 @@ static uint8_t move_alien_left_if_possible(uint8_t alien_number) {
 		return 1;
 	} else {
 		alienX--; // Proposed new X position
-		if(is_background_at(GAME_POSITION(alienX, alienY)) ||
-				is_background_at(GAME_POSITION(alienX, alienY+1))) {
-			// Can't move left because there is background in the way
-			return 0;
-		} else if(is_alien_at(GAME_POSITION(alienX, alienY)) ||
-				is_alien_at(GAME_POSITION(alienX, alienY+1))) {
-			// Can't move left because there is another alien in the way
-			return 0;			
-		}
-		// Nothing in the way - so move.
-		move_alien(alien_number, GAME_POSITION(alienX, alienY));
-		return 1;
-	}
-}
-
-// Attempt to move the alien down if possible - returns 1 if it is possible.
-// Returns 0 if another alien is in the way OR there is background in the way
-// OR the alien is at the bottom of the display.
-static uint8_t move_alien_down_if_possible(uint8_t alien_number) {
-	uint8_t bottom_left_alien_posn = alien_position[alien_number];
-	uint8_t alienX = GET_X_POSITION(bottom_left_alien_posn);
-	uint8_t alienY = GET_Y_POSITION(bottom_left_alien_posn);
-	if(alienY == 0) {
-		// Alien is at the bottom - can't move
-		return 0;
-	} else {
-		alienY--; // Proposed new Y position
-		if(is_background_at(GAME_POSITION(alienX, alienY)) ||
-				is_background_at(GAME_POSITION(alienX+1, alienY))) {
-				// Can't move down because there is background in the way
-			return 0;
-		} else if(is_alien_at(GAME_POSITION(alienX, alienY)) ||
-				is_alien_at(GAME_POSITION(alienX+1, alienY))) {
-			// Can't move down because there is another alien in the way
+		if((blocked_row(alienY) | blocked_row(alienY+1)) & (1U << alienX)) {
+			// Can't move left because there is background or another alien
+			// in the way
 			return 0;
 		}
 		// Nothing in the way - so move.
@@ -289,43 +409,24 @@ static uint8_t move_alien_down_if_possible(uint8_t alien_number) {
 	}
 }
 
-// Attempt to move the alien up if possible - returns 1 if it is possible.
-// Returns 0 if another alien is in the way OR there is background in the way
-// OR the alien is at the top of the display.
-static uint8_t move_alien_up_if_possible(uint8_t alien_number) {
-	uint8_t bottom_left_alien_posn = alien_position[alien_number];
-	uint8_t alienX = GET_X_POSITION(bottom_left_alien_posn);
-	uint8_t alienY = GET_Y_POSITION(bottom_left_alien_posn);
-	if(alienY == 6) {
-		// Alien is at the top - can't move
-		return 0;
-	} else {
-		alienY++; // Proposed new Y position
-		if(is_background_at(GAME_POSITION(alienX, alienY+1)) ||
-				is_background_at(GAME_POSITION(alienX+1, alienY+1))) {
-			// Can't move up because there is background in the way
-			return 0;
-		} else if(is_alien_at(GAME_POSITION(alienX, alienY+1)) ||
-				is_alien_at(GAME_POSITION(alienX+1, alienY+1))) {
-			// Can't move up because there is another alien in the way
-			return 0;
-		}
-		// Nothing in the way - so move. 
-		move_alien(alien_number, GAME_POSITION(alienX, alienY));
-		return 1;
-	}
-}
-
-// Helper function used by the move functions above. Move the alien to the 
-// given position. The move is known to be OK.
-// Erase the alien, update the position and redraw the alien
+// Move the alien to the given position. The move is known to be OK.
+// Erase the alien, place it in its new position and check whether it has
+// collided with the player.
 static void move_alien(uint8_t alien_number, uint8_t new_position) {
 	erase_alien(alien_number);
+	place_alien(alien_number, new_position);
+	check_if_player_is_dead();
+}
+
+// Put an (erased) alien in the given position, which is known to be free
+// of background and other aliens. Deal with any projectiles it has moved
+// into and draw the alien (if it survived).
+static void place_alien(uint8_t alien_number, uint8_t new_position) {
 	alien_position[alien_number] = new_position;
-	redraw_alien(alien_number);
 	
 	// Check whether alien has collided with a projectile (could be more than
-	// one). new_position is bottom left position
+	// one). Each hit removes the projectile, so this is done before the alien
+	// is recorded in its new position. new_position is bottom left position
 	uint8_t top_left_posn = neighbour_position(new_position, 0, 1);
 	uint8_t top_right_posn = position_to_right_of(top_left_posn);
 	uint8_t bottom_right_posn = position_to_right_of(new_position);
@@ -337,7 +438,7 @@ static void move_alien(uint8_t alien_number, uint8_t new_position) {
 	// that it hasn't been removed before doing later checks for projectile 
 	// hits. The easiest way is to check that the position of
 	// this alien number is still the same as new_position. If it is not, then
-	// it means the alien was removed from the list of aliens.
+	// it means the alien was removed (its position is now invalid).
 	if(alien_position[alien_number] == new_position && is_projectile_at(top_left_posn)) {
 		alien_hit_at(alien_number, top_left_posn);
 	}
@@ -347,13 +448,17 @@ static void move_alien(uint8_t alien_number, uint8_t new_position) {
 	if(alien_position[alien_number] == new_position && is_projectile_at(bottom_right_posn)) {
 		alien_hit_at(alien_number, bottom_right_posn);
 	}
-	
-	// Now check whether the alien has collided with the player and redraw the player. 
+	if(alien_position[alien_number] == new_position) {
+		redraw_alien(alien_number);
+		// Projectiles fired by other aliens just disappear into this one
+		uint8_t alienX = GET_X_POSITION(new_position);
+		uint8_t alienY = GET_Y_POSITION(new_position);
+		remove_projectiles_in_row(alienY, 3U << alienX);
+		remove_projectiles_in_row(alienY + 1, 3U << alienX);
+	}
 	// (Note that it is possible for an alien to move into both a player and a projectile
 	// in the same move. If this happens to be the projectile hit that destroys the alien
-	// then this will have happened before we check whether the player will die.)
-	// If the player dies, we redraw it. (We have already redrawn the alien.)
-	check_if_player_is_dead();
+	// then this will have happened before the caller checks whether the player will die.)
 }
 
 // Remove the alien from the game. (This will happen if it moves off the left
@@ -361,52 +466,52 @@ static void move_alien(uint8_t alien_number, uint8_t new_position) {
 static void remove_alien(uint8_t alien_number) {
 	// Remove the alien from the display
 	erase_alien(alien_number);
-	// Rearrange our arrays of alien positions and energies so that there are 
-	// no "holes" in them. If this alien wasn't the last in the array, we just
-	// move the last alien into this position.
-	uint8_t last_alien = num_aliens - 1;
-	if(alien_number != last_alien) {
-		// This is not the last alien - move the last one into this position
-		alien_position[alien_number] = alien_position[last_alien];
-		alien_energy[alien_number] = alien_energy[last_alien];
-	}
-	// else alien was the last one in the arrays.
-	
-	// Put an invalid position in the entry in the array that we no longer need
-	alien_position[last_alien] = INVALID_POSITION;
-	
-	// Shorten our array
+	// Mark the alien's number as unused. (Other aliens keep their numbers.)
+	alien_position[alien_number] = INVALID_POSITION;
+	live_aliens &= ~ALIEN_BIT(alien_number);
 	num_aliens -= 1;
 }
 
 //////////////////////// REDRAWING FUNCTIONS /////////////////////////////////
 
-// Erase the given alien - we replace the positions with black
+// Erase the given alien (and any hits shown on it) from the alien layers
+// and the occupancy map
 static void erase_alien(uint8_t alien_number) {
 	uint8_t alienX = GET_X_POSITION(alien_position[alien_number]);
 	uint8_t alienY = GET_Y_POSITION(alien_position[alien_number]);
 	
-	ledmatrix_update_pixel(alienX, alienY, COLOUR_BLACK);
-	ledmatrix_update_pixel(alienX, alienY + 1, COLOUR_BLACK);
-	ledmatrix_update_pixel(alienX + 1, alienY, COLOUR_BLACK);
-	ledmatrix_update_pixel(alienX + 1, alienY + 1, COLOUR_BLACK);
+	for(uint8_t deltaX = 0; deltaX <= 1; deltaX++) {
+		for(uint8_t deltaY = 0; deltaY <= 1; deltaY++) {
+			occupancy_clear(GAME_POSITION(alienX + deltaX, alienY + deltaY),
+					OCCUPANT(OCCUPANT_ALIEN, alien_number));
+			compositor_clear_pixel(LAYER_ALIENS, alienX + deltaX, alienY + deltaY);
+			compositor_clear_pixel(LAYER_ALIEN_HITS, alienX + deltaX, alienY + deltaY);
+		}
+	}
 }
 
-// Redraw the given alien in its current position.
+// Redraw the given alien in its current position (and record it in the
+// occupancy map).
 static void redraw_alien(uint8_t alien_number) {
 	uint8_t alienX = GET_X_POSITION(alien_position[alien_number]);
 	uint8_t alienY = GET_Y_POSITION(alien_position[alien_number]);
 	
-	ledmatrix_update_pixel(alienX, alienY, COLOUR_ALIEN);
-	ledmatrix_update_pixel(alienX, alienY + 1, COLOUR_ALIEN);
-	ledmatrix_update_pixel(alienX + 1, alienY, COLOUR_ALIEN);
-	ledmatrix_update_pixel(alienX + 1, alienY + 1, COLOUR_ALIEN);
+	compositor_set_pixel(LAYER_ALIENS, alienX, alienY);
+	compositor_set_pixel(LAYER_ALIENS, alienX, alienY + 1);
+	compositor_set_pixel(LAYER_ALIENS, alienX + 1, alienY);
+	compositor_set_pixel(LAYER_ALIENS, alienX + 1, alienY + 1);
+	
+	uint8_t occupant = OCCUPANT(OCCUPANT_ALIEN, alien_number);
+	occupancy_set(GAME_POSITION(alienX, alienY), occupant);
+	occupancy_set(GAME_POSITION(alienX, alienY + 1), occupant);
+	occupancy_set(GAME_POSITION(alienX + 1, alienY), occupant);
+	occupancy_set(GAME_POSITION(alienX + 1, alienY + 1), occupant);
 }
 
-// Indicate part of an alien has been hit. (Only lasts until the alien is redrawn, i.e.
-// when the background scrolls or the alien moves.)
+// Indicate part of an alien has been hit. (Only lasts until the alien moves or
+// the background scrolls.)
 static void draw_alien_hit(uint8_t position) {
 	uint8_t x = GET_X_POSITION(position);
 	uint8_t y = GET_Y_POSITION(position);
-	ledmatrix_update_pixel(x, y, COLOUR_ALIEN_HIT);
+	compositor_set_pixel(LAYER_ALIEN_HITS, x, y);
 }
\ No newline at end of file
@@ -11,19 +11,59 @@
 // (See game_position.h for how positions are recorded.)
 // Aliens can not overlap with each other, or the background
 
-// The maximum number of aliens that can appear at any one time is 5.
+// The maximum number of aliens that can appear at any one time is 5. This
+// can be changed at compile time (e.g. -DMAX_ALIENS=32) - up to 32 aliens
+// are supported. Each alien costs 2 bytes of RAM for its data plus 1 byte
+// of stack while the aliens move, and the set of aliens in use takes 1, 2
+// or 4 bytes (for up to 8, 16 or 32 aliens). The occupancy map (see
+// occupancy.h) is the same size whatever MAX_ALIENS is. The map file from
+// the build gives the exact figures.
+#ifndef MAX_ALIENS
 #define MAX_ALIENS 5
+#endif
+#if MAX_ALIENS < 1 || MAX_ALIENS > 32
+#error "MAX_ALIENS must be between 1 and 32"
+#endif
+
+// New aliens are added with their left hand side in this column (the third
+// last column), so they occupy this column and the next.
+#define ALIEN_SPAWN_X 13
 
 // Initialise alien data (no aliens to start with)
 void init_aliens(void);
 
-// Attempt to move an alien. A random alien will be moved in a random direction
-// - up, down or left - if possible. Note that the player may be dead after this
-// move if the alien moves into the player. Does nothing if there are no aliens.
-void move_random_alien(void);
+// Alien speeds are given in positions per call of move_aliens() as 8.8
+// fixed point numbers - e.g. ALIEN_SPEED(2) is two positions each time and
+// 0x0080 is one position every second time.
+#define ALIEN_SPEED(positions)	((uint16_t)(positions) << 8)
+
+// Move all the aliens. Each alien tries to move in a random direction - up,
+// down or left - and if that isn't possible, tries the other directions. 
+// (If steering is on - see below - the direction is only random when no
+// move would bring the alien closer to the player.)
+// Aliens that can't move in any direction stay where they are. Aliens that move
+// off the left hand side of the display are removed. Note that the player
+// may be dead after this if an alien moves into the player.
+// Aliens move as far as their speed (see below) allows, one position at a
+// time - each step is checked for collisions, so a fast alien can't jump
+// over the player or a projectile. After moving, an alien may fire.
+void move_aliens(void);
+
+// Set how fast the aliens move (see ALIEN_SPEED above). The speed is 
+// initially one position each time move_aliens() is called.
+void set_alien_speed(uint16_t speed);
+
+// Turn alien steering on (1) or off (0). When it is on, each alien makes
+// whichever move brings it closest to the player, going around the
+// background (see flow_field.h). If no move brings it closer than it is
+// already, it moves in a random direction as usual. The flow field must
+// be kept up to date while steering is on.
+void set_alien_steering(uint8_t steering);
+uint8_t get_alien_steering(void);
 
 // Add an alien to the game (if possible). The alien will only be added on the
-// right hand side - if there is space to do so. The alien number is returned, or
+// right hand side - if there is space to do so (no background, alien or 
+// projectile in the way). The alien number is returned, or
 // -1 will be returned if none can be added. Note that the player may be dead
 // after this if the alien is placed on top of the player. 
 int8_t add_alien_to_game(void);
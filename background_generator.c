@@ -0,0 +1,122 @@
+/*
+ * background_generator.c
+ *
+ * See background_generator.h for an overview. Only a few bytes of state
+ * are needed: the heights of the floor and ceiling, where the clear path
+ * is, any floating obstacle being generated, and a 16 bit pseudo random
+ * number generator.
+ */ 
+
+#include "background_generator.h"
+#include <stdint.h>
+
+// The clear path is this many rows high. It only moves a row at a time so
+// there are always 2 clear rows shared by neighbouring columns - enough for
+// aliens (2 rows high) to get through as well as the player.
+#define PATH_HEIGHT			3
+#define INITIAL_PATH_ROW	3
+#define NUM_ROWS			8
+
+// Largest floor and ceiling heights (in rows)
+#define MAX_FLOOR_HEIGHT	3
+#define MAX_CEILING_HEIGHT	3
+
+// A floating obstacle starts (on average) once in this many columns
+#define OBSTACLE_CHANCE		12
+
+static uint16_t random_state;
+static uint8_t background_style;
+static uint8_t path_row;		// bottom row of the clear path
+static uint8_t columns_until_path_moves;
+static uint8_t floor_height;
+static uint8_t ceiling_height;
+static uint8_t obstacle_columns_left;
+static uint8_t obstacle_bits;
+
+static uint16_t next_random(void);
+static uint8_t wander(uint8_t height, uint8_t max_height);
+
+///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
+
+void init_background_generator(uint16_t seed, uint8_t style) {
+	// The random number generator gets stuck at 0
+	random_state = seed ? seed : 1;
+	background_style = style;
+	path_row = INITIAL_PATH_ROW;
+	columns_until_path_moves = 16;
+	floor_height = 1;
+	ceiling_height = 0;
+	obstacle_columns_left = 0;
+}
+
+uint8_t generate_background_column(void) {
+	uint16_t random = next_random();
+	
+	// Move the path up or down a row every so often
+	if(columns_until_path_moves == 0) {
+		if((random & 1) && path_row < NUM_ROWS - PATH_HEIGHT) {
+			path_row++;
+		} else if(path_row > 0) {
+			path_row--;
+		}
+		columns_until_path_moves = 4 + (random >> 8) % 6;
+	} else {
+		columns_until_path_moves--;
+	}
+	
+	uint8_t column = 0;
+	if(background_style & BACKGROUND_STYLE_FLOOR) {
+		floor_height = wander(floor_height, MAX_FLOOR_HEIGHT);
+		column |= (1 << floor_height) - 1;
+	}
+	if(background_style & BACKGROUND_STYLE_CEILING) {
+		ceiling_height = wander(ceiling_height, MAX_CEILING_HEIGHT);
+		column |= (uint8_t)(0xFF00 >> ceiling_height);
+	}
+	if(background_style & BACKGROUND_STYLE_OBSTACLES) {
+		if(obstacle_columns_left) {
+			obstacle_columns_left--;
+			column |= obstacle_bits;
+		} else if((random >> 4) % OBSTACLE_CHANCE == 0) {
+			// Start a block 1 or 2 rows high and 2 to 5 columns wide
+			// somewhere between rows 1 and 6
+			uint16_t shape = next_random();
+			obstacle_bits = ((shape & 1) ? 0x03 : 0x01) << (1 + (shape >> 1) % 5);
+			obstacle_columns_left = 1 + (shape >> 4) % 4;
+			column |= obstacle_bits;
+		}
+	}
+	
+	// Nothing is ever allowed in the path
+	column &= ~(((1 << PATH_HEIGHT) - 1) << path_row);
+	return column;
+}
+
+/////////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+// Return the next number from a 16 bit xorshift pseudo random number
+// generator
+static uint16_t next_random(void) {
+	random_state ^= random_state << 7;
+	random_state ^= random_state >> 9;
+	random_state ^= random_state << 8;
+	return random_state;
+}
+
+// Randomly move the given height up or down by one (or leave it alone),
+// keeping it between 0 and max_height
+static uint8_t wander(uint8_t height, uint8_t max_height) {
+	switch(next_random() & 3) {
+		case 0:
+			if(height > 0) {
+				height--;
+			}
+			break;
+		case 1:
+			if(height < max_height) {
+				height++;
+			}
+			break;
+	}
+	return height;
+}
@@ -0,0 +1,29 @@
+/*
+ * background_generator.h
+ *
+ * Generates the background one column at a time as it scrolls on to the
+ * display. The same seed always gives the same background. The background
+ * never repeats, and it always leaves a clear path (at least 3 rows high,
+ * which moves up or down by no more than a row at a time) so that the
+ * player can always get through.
+ */ 
+
+#ifndef BACKGROUND_GENERATOR_H_
+#define BACKGROUND_GENERATOR_H_
+
+#include <stdint.h>
+
+// Styles of background (which can be combined)
+#define BACKGROUND_STYLE_FLOOR		0x01	// background along the bottom
+#define BACKGROUND_STYLE_CEILING	0x02	// background along the top
+#define BACKGROUND_STYLE_OBSTACLES	0x04	// floating blocks of background
+
+// Start generating a new background from the given seed. The clear path
+// starts out over rows 3 to 5 and stays there for the first 16 columns
+// (so the player is never in the background at the start).
+void init_background_generator(uint16_t seed, uint8_t style);
+
+// Return the next column of background. Bit 0 is the bottom row (row 0).
+uint8_t generate_background_column(void);
+
+#endif /* BACKGROUND_GENERATOR_H_ */
@@ -7,6 +7,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "buttons.h"
+#include "timer1.h"
 
 // Global variable to keep track of the last button state so that we 
 // can detect changes when an interrupt fires. The lower 4 bits (0 to 3)
@@ -19,8 +20,11 @@ static volatile uint8_t last_button_state;
 // short. In most uses it will never have more than 1 element at a time.
 // This button queue can be changed by the interrupt handler below so we should
 // turn off interrupts if we're changing the queue outside the handler.
+// button_time[i] is the time (the low 16 bits of the clock tick count) at
+// which the push in button_queue[i] happened.
 #define BUTTON_QUEUE_SIZE 4
 static volatile uint8_t button_queue[BUTTON_QUEUE_SIZE];
+static volatile uint16_t button_time[BUTTON_QUEUE_SIZE];
 static volatile int8_t queue_length;
 
 // Setup interrupt if any of pins B0 to B3 change. We do this
@@ -44,6 +48,11 @@ void init_button_interrupts(void) {
 }
 
 int8_t button_pushed(void) {
+	uint16_t time;
+	return button_pushed_at(&time);
+}
+
+int8_t button_pushed_at(uint16_t* time) {
 	int8_t return_value = NO_BUTTON_PUSHED;	// Assume no button pushed
 	if(queue_length > 0) {
 		// Remove the first element off the queue and move all the other
@@ -51,6 +60,7 @@ int8_t button_pushed(void) {
 		// before we make any changes to the queue. If interrupts were on
 		// we turn them back on when done.
 		return_value = button_queue[0];
+		*time = button_time[0];
 		
 		// Save whether interrupts were enabled and turn them off
 		int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
@@ -58,6 +68,7 @@ int8_t button_pushed(void) {
 		
 		for(uint8_t i = 1; i < queue_length; i++) {
 			button_queue[i-1] = button_queue[i];
+			button_time[i-1] = button_time[i];
 		}
 		queue_length--;
 		
@@ -74,6 +85,7 @@ ISR(PCINT1_vect) {
 	// Get the current state of the buttons. We'll compare this with
 	// the last state to see what has changed.
 	uint8_t button_state = PINB & 0x0F;
+	uint16_t now = (uint16_t)get_current_time();
 	
 	// Iterate over all the buttons and see which ones have changed.
 	// Any button pushes are added to the queue of button pushes (if
@@ -86,6 +98,7 @@ ISR(PCINT1_vect) {
 				!(last_button_state & (1<<pin))) {
 			// Add the button push to the queue (and update the
 			// length of the queue
+			button_time[queue_length] = now;
 			button_queue[queue_length++] = pin;
 		}
 	}
@@ -30,5 +30,11 @@ void init_button_interrupts(void);
 
 int8_t button_pushed(void);
 
+/* As for button_pushed(), but if a button push is returned *time is set to
+ * the time it happened - the low 16 bits of get_current_time() when the
+ * push was seen.
+ */
+int8_t button_pushed_at(uint16_t* time);
+
 
 #endif /* BUTTONS_H_ */
\ No newline at end of file
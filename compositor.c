@@ -0,0 +1,183 @@
+/*
+ * compositor.c
+ *
+ * See compositor.h for an overview.
+ */ 
+
+#include "compositor.h"
+#include "ledmatrix.h"
+#include "game_position.h"
+#include <stdint.h>
+
+// The pixels of each layer - bit x of layer_rows[layer][y] is pixel (x,y)
+static uint16_t layer_rows[NUM_LAYERS][MATRIX_NUM_ROWS];
+static PixelColour layer_colour[NUM_LAYERS];
+
+// Pixels which may have changed colour since the last render
+static uint16_t changed_rows[MATRIX_NUM_ROWS];
+
+// Pixel updates the game has asked for since the last render, and the
+// number we have given to the LED matrix (see ledmatrix_count_merged_pixels())
+static uint16_t pixels_requested;
+static uint16_t pixels_passed_on;
+
+// The subsystem each layer's SPI usage is charged to (see ledmatrix.h)
+static const LedmatrixSubsystem layer_subsystem[NUM_LAYERS] = {
+	LEDMATRIX_SUBSYSTEM_BACKGROUND,		// LAYER_BACKGROUND
+	LEDMATRIX_SUBSYSTEM_ALIENS,			// LAYER_ALIENS
+	LEDMATRIX_SUBSYSTEM_ALIENS,			// LAYER_ALIEN_HITS
+	LEDMATRIX_SUBSYSTEM_PROJECTILES,	// LAYER_PROJECTILES
+	LEDMATRIX_SUBSYSTEM_PROJECTILES,	// LAYER_ALIEN_PROJECTILES
+	LEDMATRIX_SUBSYSTEM_PLAYER,			// LAYER_PLAYER
+	LEDMATRIX_SUBSYSTEM_SCROLLER		// LAYER_HUD
+};
+
+static void update_changed_pixels(void);
+static uint8_t count_pixels(uint16_t row_bits);
+
+void compositor_set_layer_colour(Layer layer, PixelColour colour) {
+	if(layer_colour[layer] == colour) {
+		return;
+	}
+	layer_colour[layer] = colour;
+	// Every pixel in this layer may now look different
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		changed_rows[y] |= layer_rows[layer][y];
+		pixels_requested += count_pixels(layer_rows[layer][y]);
+	}
+}
+
+void compositor_set_pixel(Layer layer, uint8_t x, uint8_t y) {
+	if(x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS) {
+		return;
+	}
+	layer_rows[layer][y] |= (1U << x);
+	changed_rows[y] |= (1U << x);
+	pixels_requested++;
+}
+
+void compositor_clear_pixel(Layer layer, uint8_t x, uint8_t y) {
+	if(x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS) {
+		return;
+	}
+	layer_rows[layer][y] &= ~(1U << x);
+	changed_rows[y] |= (1U << x);
+	pixels_requested++;
+}
+
+void compositor_set_column(Layer layer, uint8_t x, uint8_t column_bits) {
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		if(column_bits & (1 << y)) {
+			compositor_set_pixel(layer, x, y);
+		} else {
+			compositor_clear_pixel(layer, x, y);
+		}
+	}
+}
+
+void compositor_set_row(Layer layer, uint8_t y, uint16_t row_bits) {
+	changed_rows[y] |= layer_rows[layer][y] ^ row_bits;
+	pixels_requested += count_pixels(layer_rows[layer][y] ^ row_bits);
+	layer_rows[layer][y] = row_bits;
+}
+
+void compositor_clear_layer(Layer layer) {
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		changed_rows[y] |= layer_rows[layer][y];
+		pixels_requested += count_pixels(layer_rows[layer][y]);
+		layer_rows[layer][y] = 0;
+	}
+}
+
+void compositor_scroll_layer_left(Layer layer, uint8_t new_column_bits) {
+	// The matrix must be showing exactly what the layers describe before
+	// it is shifted
+	update_changed_pixels();
+	ledmatrix_set_subsystem(layer_subsystem[layer]);
+	ledmatrix_shift_display_left();
+	
+	// After the shift, pixel (x,y) shows what was at (x+1,y). This is still
+	// right unless one of the layers that didn't move differs between
+	// those two pixels. The new right hand column always needs drawing.
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		layer_rows[layer][y] >>= 1;
+		for(uint8_t other = 0; other < NUM_LAYERS; other++) {
+			if(other != layer) {
+				changed_rows[y] |= layer_rows[other][y] ^ (layer_rows[other][y] >> 1);
+			}
+		}
+		changed_rows[y] |= (1U << (MATRIX_NUM_COLUMNS - 1));
+	}
+	compositor_set_column(layer, MATRIX_NUM_COLUMNS - 1, new_column_bits);
+}
+
+uint16_t compositor_get_row(Layer layer, uint8_t y) {
+	if(y >= MATRIX_NUM_ROWS) {
+		return 0;
+	}
+	return layer_rows[layer][y];
+}
+
+uint8_t compositor_is_set_at(Layer layer, uint8_t position) {
+	return (compositor_get_row(layer, GET_Y_POSITION(position)) >> 
+			GET_X_POSITION(position)) & 1;
+}
+
+void compositor_invalidate(void) {
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		changed_rows[y] = 0xFFFF;
+	}
+}
+
+void compositor_render(void) {
+	update_changed_pixels();
+	// Count the updates that were merged into others here (some pixels we
+	// send - e.g. after a scroll - weren't asked for by anyone)
+	if(pixels_requested > pixels_passed_on) {
+		ledmatrix_count_merged_pixels(pixels_requested - pixels_passed_on);
+	}
+	pixels_requested = 0;
+	pixels_passed_on = 0;
+	ledmatrix_flush();
+}
+
+// Work out the colour of each pixel that may have changed and give it to
+// the LED matrix. (The matrix ignores pixels that end up the same colour.)
+// Player and projectile pixels are sent urgently so that they appear
+// promptly even if a large update is waiting to be sent.
+static void update_changed_pixels(void) {
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		for(uint8_t x = 0; changed_rows[y] && x < MATRIX_NUM_COLUMNS; x++) {
+			uint16_t bit = (1U << x);
+			if(!(changed_rows[y] & bit)) {
+				continue;
+			}
+			changed_rows[y] &= ~bit;
+			pixels_passed_on++;
+			
+			// Find the highest layer with this pixel set
+			int8_t layer = NUM_LAYERS - 1;
+			while(layer >= 0 && !(layer_rows[layer][y] & bit)) {
+				layer--;
+			}
+			// (Erased pixels stay charged to whatever drew them.)
+			if(layer < 0) {
+				ledmatrix_update_pixel(x, y, COLOUR_BLACK);
+			} else if(layer == LAYER_PLAYER || layer == LAYER_PROJECTILES) {
+				ledmatrix_set_subsystem(layer_subsystem[layer]);
+				ledmatrix_update_pixel_urgent(x, y, layer_colour[layer]);
+			} else {
+				ledmatrix_set_subsystem(layer_subsystem[layer]);
+				ledmatrix_update_pixel(x, y, layer_colour[layer]);
+			}
+		}
+	}
+}
+
+static uint8_t count_pixels(uint16_t row_bits) {
+	uint8_t count = 0;
+	for(; row_bits; row_bits &= row_bits - 1) {
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,74 @@
+/*
+ * compositor.h
+ *
+ * The game modules don't draw on the LED matrix directly. Each draws into
+ * its own layer and once per frame compositor_render() works out the
+ * colour of every pixel that may have changed and sends it to the matrix.
+ * Each layer is one bit per pixel (a 16 bit mask per row) with a single
+ * colour for the whole layer. Where layers overlap the pixel takes the
+ * colour of the highest layer - layers are listed below from the bottom
+ * up.
+ *
+ * The layers also serve as the game's record of what is where. Each game
+ * module keeps its layer up to date as things move, so collision checks
+ * can test a whole row of the field at once (see compositor_get_row()).
+ */ 
+
+#ifndef COMPOSITOR_H_
+#define COMPOSITOR_H_
+
+#include <stdint.h>
+#include "pixel_colour.h"
+
+typedef enum {
+	LAYER_BACKGROUND,
+	LAYER_ALIENS,
+	LAYER_ALIEN_HITS,	// parts of aliens that have just been hit
+	LAYER_PROJECTILES,
+	LAYER_ALIEN_PROJECTILES,
+	LAYER_PLAYER,
+	LAYER_HUD,			// anything to be shown over the top of the game
+	NUM_LAYERS
+} Layer;
+
+// Set the colour used for all pixels in the given layer
+void compositor_set_layer_colour(Layer layer, PixelColour colour);
+
+// Set or clear a pixel in the given layer. x must be < MATRIX_NUM_COLUMNS
+// and y must be < MATRIX_NUM_ROWS or the request will be ignored.
+void compositor_set_pixel(Layer layer, uint8_t x, uint8_t y);
+void compositor_clear_pixel(Layer layer, uint8_t x, uint8_t y);
+
+// Set column x of the given layer. Bit i of column_bits is row i. 
+void compositor_set_column(Layer layer, uint8_t x, uint8_t column_bits);
+
+// Set row y of the given layer - bit x of row_bits is pixel (x,y). Only
+// the pixels that change will be redrawn. y must be < MATRIX_NUM_ROWS.
+void compositor_set_row(Layer layer, uint8_t y, uint16_t row_bits);
+
+// Clear every pixel in the given layer
+void compositor_clear_layer(Layer layer);
+
+// Move the contents of the given layer one column to the left and put
+// the given column in the right hand column. The LED matrix is shifted
+// too, so only pixels where the other layers don't line up with what has
+// moved need to be sent.
+void compositor_scroll_layer_left(Layer layer, uint8_t new_column_bits);
+
+// Return row y of the given layer - bit x is set if pixel (x,y) is set.
+// Returns 0 if y is not a valid row.
+uint16_t compositor_get_row(Layer layer, uint8_t y);
+
+// Return 1 if the pixel at the given game position (see game_position.h)
+// is set in the given layer, 0 otherwise (or if the position is invalid)
+uint8_t compositor_is_set_at(Layer layer, uint8_t position);
+
+// Treat every pixel as changed - used when something other than the
+// compositor has drawn on the matrix
+void compositor_invalidate(void);
+
+// Send every pixel that has changed since the last render to the LED
+// matrix (and flush the matrix). Should be called once per frame.
+void compositor_render(void);
+
+#endif /* COMPOSITOR_H_ */
@@ -0,0 +1,166 @@
+/*
+ * flow_field.c
+ *
+ * See flow_field.h for an overview. The distance at a position is 0 for
+ * the player's positions, FLOW_FIELD_FAR for background, and otherwise 1
+ * more than the smallest distance of its four neighbours. A position is
+ * marked as needing an update when it (or its neighbour) changes. Updating
+ * a position recalculates its distance from its neighbours and, if that
+ * changes, marks the neighbours. This settles on the correct distances
+ * whether they have gone up or down.
+ */ 
+
+#include "flow_field.h"
+#include "compositor.h"
+#include "game_position.h"
+#include "player.h"
+#include <stdint.h>
+
+#define NUM_COLUMNS		16
+#define NUM_ROWS		8
+
+// Distance at each position (x,y). (Paths around the background can be
+// much longer than the width of the field, so these need a whole byte.)
+static uint8_t distance[NUM_ROWS][NUM_COLUMNS];
+
+// Positions needing an update - bit x of needs_update[y] is set if
+// position (x,y) needs updating. next_row is the row we'll look at first 
+// next time.
+static uint16_t needs_update[NUM_ROWS];
+static uint8_t next_row;
+
+// The background and player position that the field was last updated for
+static uint16_t known_background[NUM_ROWS];
+static uint8_t known_player_position;
+
+static uint8_t get_distance(uint8_t x, uint8_t y);
+static void set_distance(uint8_t x, uint8_t y, uint8_t new_distance);
+static void mark_for_update(uint8_t x, uint8_t y);
+static void mark_player_for_update(uint8_t player_position);
+static void update_position(uint8_t x, uint8_t y);
+
+///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
+
+void init_flow_field(void) {
+	for(uint8_t y = 0; y < NUM_ROWS; y++) {
+		for(uint8_t x = 0; x < NUM_COLUMNS; x++) {
+			distance[y][x] = FLOW_FIELD_FAR;
+		}
+		needs_update[y] = 0xFFFF;
+		known_background[y] = compositor_get_row(LAYER_BACKGROUND, y);
+	}
+	next_row = 0;
+	known_player_position = get_player_position();
+}
+
+void flow_field_update(void) {
+	// Mark any positions where the background has appeared or gone, and the
+	// player's old and new positions if the player has moved
+	for(uint8_t y = 0; y < NUM_ROWS; y++) {
+		uint16_t background = compositor_get_row(LAYER_BACKGROUND, y);
+		needs_update[y] |= background ^ known_background[y];
+		known_background[y] = background;
+	}
+	uint8_t player_position = get_player_position();
+	if(player_position != known_player_position) {
+		mark_player_for_update(known_player_position);
+		mark_player_for_update(player_position);
+		known_player_position = player_position;
+	}
+	
+	// Update positions, working through the rows from where we left off
+	// last time
+	uint8_t budget = FLOW_FIELD_UPDATE_BUDGET;
+	for(uint8_t rows_checked = 0; budget && rows_checked < NUM_ROWS; ) {
+		uint8_t y = next_row;
+		if(needs_update[y]) {
+			uint8_t x = 0;
+			while(!(needs_update[y] & (1U << x))) {
+				x++;
+			}
+			needs_update[y] &= ~(1U << x);
+			update_position(x, y);
+			budget--;
+		} else {
+			next_row = (next_row + 1) % NUM_ROWS;
+			rows_checked++;
+		}
+	}
+}
+
+uint8_t flow_field_distance(uint8_t position) {
+	if(GET_Y_POSITION(position) >= NUM_ROWS) {
+		return FLOW_FIELD_FAR;
+	}
+	return get_distance(GET_X_POSITION(position), GET_Y_POSITION(position));
+}
+
+uint8_t flow_field_settled(void) {
+	for(uint8_t y = 0; y < NUM_ROWS; y++) {
+		if(needs_update[y]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/////////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+static uint8_t get_distance(uint8_t x, uint8_t y) {
+	return distance[y][x];
+}
+
+static void set_distance(uint8_t x, uint8_t y, uint8_t new_distance) {
+	distance[y][x] = new_distance;
+}
+
+// Mark the given position for update (if it is on the game field)
+static void mark_for_update(uint8_t x, uint8_t y) {
+	if(x < NUM_COLUMNS && y < NUM_ROWS) {
+		needs_update[y] |= (1U << x);
+	}
+}
+
+// Mark both positions the player occupies when at the given position
+static void mark_player_for_update(uint8_t player_position) {
+	uint8_t x = GET_X_POSITION(player_position);
+	uint8_t y = GET_Y_POSITION(player_position);
+	mark_for_update(x, y);
+	mark_for_update(x + 1, y);
+}
+
+// Recalculate the distance at the given position. If it changes, the
+// neighbours will need updating too.
+static void update_position(uint8_t x, uint8_t y) {
+	uint8_t new_distance;
+	uint8_t playerX = GET_X_POSITION(known_player_position);
+	if(y == GET_Y_POSITION(known_player_position) && (x == playerX || x == playerX + 1)) {
+		new_distance = 0;
+	} else if(known_background[y] & (1U << x)) {
+		new_distance = FLOW_FIELD_FAR;
+	} else {
+		// 1 more than the closest neighbour. (Positions off the edge of the
+		// game field are treated as far away.)
+		uint8_t closest = FLOW_FIELD_FAR;
+		if(x > 0 && get_distance(x - 1, y) < closest) {
+			closest = get_distance(x - 1, y);
+		}
+		if(x < NUM_COLUMNS - 1 && get_distance(x + 1, y) < closest) {
+			closest = get_distance(x + 1, y);
+		}
+		if(y > 0 && get_distance(x, y - 1) < closest) {
+			closest = get_distance(x, y - 1);
+		}
+		if(y < NUM_ROWS - 1 && get_distance(x, y + 1) < closest) {
+			closest = get_distance(x, y + 1);
+		}
+		new_distance = (closest < FLOW_FIELD_FAR) ? closest + 1 : FLOW_FIELD_FAR;
+	}
+	if(new_distance != get_distance(x, y)) {
+		set_distance(x, y, new_distance);
+		mark_for_update(x - 1, y);
+		mark_for_update(x + 1, y);
+		mark_for_update(x, y - 1);
+		mark_for_update(x, y + 1);
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * flow_field.h
+ *
+ * Keeps a field of distances from every position on the game field to the
+ * player, going around the background, which aliens can use to steer
+ * towards the player. Rather than being recalculated whenever the
+ * background scrolls or the player moves, the field notices which
+ * positions have changed and fixes up the distances from there, a few
+ * positions at a time, so the cost of each update is bounded. Between
+ * updates (and just after a change) distances may be slightly out of
+ * date.
+ */ 
+
+#ifndef FLOW_FIELD_H_
+#define FLOW_FIELD_H_
+
+#include <stdint.h>
+
+// Distance used for positions that can't reach the player at all
+// (including background). Real distances are always less than this - a
+// path can't be longer than the number of positions on the field.
+#define FLOW_FIELD_FAR		255
+
+// The most positions that one call to flow_field_update() will work on
+#define FLOW_FIELD_UPDATE_BUDGET	8
+
+// Start a new field. Every distance will be worked out again over the next
+// few updates.
+void init_flow_field(void);
+
+// Check for changes to the background and the player's position and
+// update (up to FLOW_FIELD_UPDATE_BUDGET) positions. This should be called
+// frequently (e.g. every time through the game loop).
+void flow_field_update(void);
+
+// Return the distance from the given position to the player (or
+// FLOW_FIELD_FAR for invalid positions)
+uint8_t flow_field_distance(uint8_t position);
+
+// Return 1 if no positions are waiting to be updated, 0 otherwise. (Changes
+// since the last flow_field_update() aren't known about yet.)
+uint8_t flow_field_settled(void);
+
+#endif /* FLOW_FIELD_H_ */
@@ -5,6 +5,7 @@
  */ 
 
 #include "ledmatrix.h"
+#include "compositor.h"
 #include "pixel_colour.h"
 #include "game_position.h"
 #include "game_background.h"
@@ -12,123 +13,36 @@
 #include "player.h"
 #include "projectile.h"
 #include "level.h"
+#include "background_generator.h"
+#include "level_pack.h"
 #include <stdint.h>
-#include <string.h>
+#include <avr/pgmspace.h>
+
+// The background is decoded or generated a column at a time as it scrolls
+// on (see level_design.h). next_column is the column that will appear at
+// the right hand side when the background next scrolls. Bit 0 (LSB) is
+// the bottom of the display (row 0).
+static uint8_t next_column;
+
+// The design of the current level (copied from program memory). Once all
+// the designs have been played they are played again from the first.
+static LevelDesign level;
+
+// Where we're up to in a designed level's run length coded terrain - the
+// next run to read, plus the column being repeated and how many more
+// times it is to be repeated
+static const uint8_t* next_run;
+static uint8_t run_column;
+static uint8_t run_remaining;
+
+// The background in the columns where aliens are added (ALIEN_SPAWN_X and
+// ALIEN_SPAWN_X+1) and the column after, from left to right (as they would
+// be shown on the display - bit 0 is row 0). When the background scrolls
+// these move along one and the new column is added at the end.
+#define NUM_SPAWN_COLUMNS		3
+static uint8_t spawn_columns[NUM_SPAWN_COLUMNS];
+static uint8_t free_spawn_spans;
 
-// Background - 8 bits for each column. A 1 indicates background being
-// present, a 0 is empty space. We will scroll through this and
-// return to the other end. Bit 0 (LSB) in these patterns will end
-// up on the bottom of the display (row 0).
-#define NUM_GAME_COLUMNS 32
-uint8_t background_data[NUM_GAME_COLUMNS] = {
-	0b00000011,
-	0b00000111,
-	0b00000111,
-	0b00000111,
-	0b00000011,
-	0b00000001,
-	0b00000001,
-	0b00000001,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000001,
-	0b00000001,
-	0b00000011,
-	0b00000011,
-	0b00000001,
-	0b00000001,
-	0b00010000,
-	0b00011000,
-	0b00011000,
-	0b00111100,
-	0b00111100,
-	0b00111000,
-	0b00011000,
-	0b00010000,
-	0b00000001,
-	0b00000001,
-	0b00000001,
-	0b00000011,
-	0b00000111,
-	0b00000111
-};
-
-uint8_t background_data_original[NUM_GAME_COLUMNS] = {
-	0b00000011,
-	0b00000111,
-	0b00000111,
-	0b00000111,
-	0b00000011,
-	0b00000001,
-	0b00000001,
-	0b00000001,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000000,
-	0b00000001,
-	0b00000001,
-	0b00000011,
-	0b00000011,
-	0b00000001,
-	0b00000001,
-	0b00010000,
-	0b00011000,
-	0b00011000,
-	0b00111100,
-	0b00111100,
-	0b00111000,
-	0b00011000,
-	0b00010000,
-	0b00000001,
-	0b00000001,
-	0b00000001,
-	0b00000011,
-	0b00000111,
-	0b00000111
-};
-
-uint8_t background_data_even[NUM_GAME_COLUMNS] = {
-	0b00000011,
-	0b00000111,
-	0b00000111,
-	0b00000011,
-	0b00000011,
-	0b00000001,
-	0b10001111,
-	0b10000001,
-	0b11000000,
-	0b11100000,
-	0b00000000,
-	0b00000000,
-	0b00000001,
-	0b00000001,
-	0b00000011,
-	0b00000011,
-	0b00000001,
-	0b00000001,
-	0b00010000,
-	0b00011000,
-	0b00011000,
-	0b00111100,
-	0b00111100,
-	0b00111000,
-	0b00011000,
-	0b00010000,
-	0b00000001,
-	0b00000001,
-	0b00000001,
-	0b00000011,
-	0b00000111,
-	0b00000111
-};
-
-
-// Which column is at the left of the screen - starting at 0 and counting up
-// until NUM_GAME_COLUMNS-1 - we then wrap around.
-static uint8_t scroll_position;
 // counter for background
 uint8_t level_count = 1;
 
@@ -136,29 +50,43 @@ uint8_t level_count = 1;
 uint8_t background_colour;
 
 // Helper functions
+static uint8_t next_background_column(void);
 static void draw_initial_background(void);
-static void draw_background_column(uint8_t column);
-static void update_background_display_after_scroll(void);
+static void add_spawn_column(uint8_t column);
+static void remove_projectiles_in_path_of_background(void);
 
 
 ///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
 
 
 void choose_background(void) {
-	if (level_count % 2 == 1) {
-		memcpy(background_data, background_data_original, NUM_GAME_COLUMNS);
-		background_colour = COLOUR_GREEN;
-		} else if (level_count % 2 == 0) {
-		memcpy(background_data, background_data_even, NUM_GAME_COLUMNS);
-		background_colour = COLOUR_LIGHT_YELLOW;
+	memcpy_P(&level, &level_designs[(level_count - 1) % NUM_LEVEL_DESIGNS], 
+			sizeof(LevelDesign));
+	if(level.terrain) {
+		next_run = level.terrain;
+		run_remaining = 0;
+	} else {
+		init_background_generator(level.seed, level.style);
 	}
+	background_colour = level.colour;
+	compositor_set_layer_colour(LAYER_BACKGROUND, background_colour);
+}
+
+uint16_t get_level_alien_move_ms(void) {
+	return level.alien_move_ms;
+}
+
+uint16_t get_level_alien_add_ms(void) {
+	return level.alien_add_ms;
 }
 
 // Initialise background data
 void init_background(void) {
-	scroll_position = 0;
-	draw_initial_background();
+	// Choose the background before drawing it. (Scrolling only draws the
+	// new right hand column so anything drawn wrongly here would stay on
+	// the display until it scrolled off.)
 	choose_background();
+	draw_initial_background();
 
 }
 
@@ -171,18 +99,14 @@ void reset_level_counter(void) {
 }
 
 
-// Return 1 if there is background at the given position, 0 otherwise
+// Return 1 if there is background at the given position, 0 otherwise.
+// (The background layer always holds the visible part of the background.)
 uint8_t is_background_at(uint8_t position) {
-	uint8_t row = GET_Y_POSITION(position);
-	uint8_t column = GET_X_POSITION(position);
-	// Work out which column number this is in our background array
-	uint8_t background_col_number = (column + scroll_position) % NUM_GAME_COLUMNS;
-	uint8_t background_col_data = background_data[background_col_number];
-	if(background_col_data & (1<< row)) {
-		return 1;
-	} else {
-		return 0;
-	}
+	return compositor_is_set_at(LAYER_BACKGROUND, position);
+}
+
+uint8_t get_free_spawn_spans(void) {
+	return free_spawn_spans;
 }
 
 // Scroll the background to the left by one position.
@@ -190,82 +114,84 @@ void scroll_background(void) {
 	// Check for any aliens that the background will run into and move
 	// or remove them
 	check_aliens_prior_to_background_scroll();
+	// Projectiles that the background scrolls into are removed
+	remove_projectiles_in_path_of_background();
 	
-	// scroll_position indicates which column in the background data is
-	// shown at column 0 on the display. We increment this and check if
-	// need to wrap around back to the start.
-	scroll_position++;
-	if(scroll_position == NUM_GAME_COLUMNS) {
-		scroll_position = 0;
-	}
-	
-	// Update the display
-	update_background_display_after_scroll();
+	// Update the display. Alien hits are only shown until the background
+	// scrolls. The background layer moves one column to the left and we
+	// add the new right hand column. Then we work out the column after.
+	compositor_clear_layer(LAYER_ALIEN_HITS);
+	compositor_scroll_layer_left(LAYER_BACKGROUND, next_column);
+	add_spawn_column(next_column);
+	next_column = next_background_column();
 	
-	// Check whether the player is dead or not. (Will redraw player if so.)
+	// Check whether the player is dead or not.
 	check_if_player_is_dead();
 }
 
 /////////////////////// STATIC FUNCTIONS /////////////////////////////////////
 
+// Return the next column of the current level's background
+static uint8_t next_background_column(void) {
+	if(!level.terrain) {
+		return generate_background_column();
+	}
+	if(run_remaining == 0) {
+		uint8_t count = pgm_read_byte(next_run);
+		if(count == 0) {
+			// End of the terrain - start again from the beginning
+			next_run = level.terrain;
+			count = pgm_read_byte(next_run);
+		}
+		run_column = pgm_read_byte(next_run + 1);
+		run_remaining = count;
+		next_run += 2;
+	}
+	run_remaining--;
+	return run_column;
+}
+
 // Clear the screen and draw the background. The player is not drawn.
 void draw_initial_background() {
-	// Clear the display
+	// Clear the display. Everything will need to be drawn again.
+	ledmatrix_set_subsystem(LEDMATRIX_SUBSYSTEM_BACKGROUND);
 	ledmatrix_clear();
+	compositor_invalidate();
 	
-	uint8_t column;
-	for(column = 0; column <= 15; column++) {
-		draw_background_column(column);
+	for(uint8_t column = 0; column <= 15; column++) {
+		uint8_t column_data = next_background_column();
+		compositor_set_column(LAYER_BACKGROUND, column, column_data);
+		add_spawn_column(column_data);
 	}
+	next_column = next_background_column();
 }
 
-// Draw the column with the given number (0 to 15). The player is not drawn.
-static void draw_background_column(uint8_t column) {
-	MatrixColumn column_display_data;
-	uint8_t i;
-	uint8_t game_column = scroll_position + column;
-	uint8_t background_column_data = background_data[game_column % NUM_GAME_COLUMNS];
-	for(i=0;i<=7;i++) {
-		if(background_column_data & (1<<i) ) {
-			// Bit i is set, meaning background is present
-			column_display_data[i] = background_colour;
-		} else {
-			column_display_data[i] = COLOUR_BLACK;
-		}
+// Record a new column of background on the right hand side of the display
+// and work out where aliens can be added
+static void add_spawn_column(uint8_t column) {
+	for(uint8_t i = 0; i < NUM_SPAWN_COLUMNS - 1; i++) {
+		spawn_columns[i] = spawn_columns[i + 1];
 	}
-	ledmatrix_update_column(column, column_display_data);
+	spawn_columns[NUM_SPAWN_COLUMNS - 1] = column;
+	uint8_t background = spawn_columns[0] | spawn_columns[1];
+	// Bit y of the spans is set if rows y and y+1 are clear. (Row 7 can't
+	// be the bottom of an alien.)
+	free_spawn_spans = ~(background | (background >> 1)) & 0x7F;
 }
 
-static void update_background_display_after_scroll(void) {
-	// We iterate over our background and erase pixels that 
-	// are no longer part of the background - and add those 
-	// that now are part of the background. We need to work out 
-	// the background column data that was in this column and
-	// the background column data that will be in this column.
-	for(uint8_t column = 0; column <= 15; column++) {
-		int8_t old_game_column = scroll_position + column - 1;
-		if(old_game_column < 0) {
-			// If the last column of data in the background array has just scrolled
-			// off the left hand side, then we need to get the data from the
-			// end of the array, not the previous position.
-			// (old_game_column should only ever be -1 at this point)
-			old_game_column += NUM_GAME_COLUMNS;
-		}
-		uint8_t new_game_column = scroll_position + column;
-		uint8_t old_column_data = background_data[old_game_column % NUM_GAME_COLUMNS];
-		uint8_t new_column_data = background_data[new_game_column % NUM_GAME_COLUMNS];
-		for(uint8_t row=0; row <= 7; row++) {
-			if( (old_column_data & (1<<row)) != (new_column_data & (1<<row)) ) {
-				// Pixel has changed
-				if(new_column_data & (1<<row)) {
-					// Background is now present
-					// Remove any projectile that is in this position
-					remove_any_projectile_at(GAME_POSITION(column,row));
-					ledmatrix_update_pixel(column, row, background_colour);
-				} else {
-					ledmatrix_update_pixel(column, row, COLOUR_BLACK);
-				}
-			}
+// Remove any projectile in a position where background is about to
+// appear when the background scrolls one column to the left. Must be
+// called before the background layer is scrolled. 
+static void remove_projectiles_in_path_of_background(void) {
+	for(uint8_t row = 0; row <= 7; row++) {
+		// After the scroll, this row of the background will be the current
+		// row moved one to the left, with the new column on the right
+		uint16_t old_row = compositor_get_row(LAYER_BACKGROUND, row);
+		uint16_t new_row = old_row >> 1;
+		if(next_column & (1 << row)) {
+			new_row |= (1U << 15);
 		}
+		// Pixels which are set in the new row but not in the old row
+		remove_projectiles_in_row(row, new_row & ~old_row);
 	}
-}
\ No newline at end of file
+}
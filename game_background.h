@@ -15,12 +15,22 @@ void increment_level_counter(void);
 void reset_level_counter(void);
 void choose_background(void);
 
+// Alien timing for the current level (from its design), in milliseconds
+uint16_t get_level_alien_move_ms(void);
+uint16_t get_level_alien_add_ms(void);
+
 // Initialise background data and draw the background (after clearing the display)
 void init_background(void);
 
 // Returns 1 if there is background at the given position, 0 otherwise
 uint8_t is_background_at(uint8_t position);
 
+// Return where an alien could be added as far as the background is 
+// concerned - bit y is set if rows y and y+1 of columns ALIEN_SPAWN_X and
+// ALIEN_SPAWN_X+1 (see alien.h) are clear of background. (This is kept up
+// to date as the background scrolls.)
+uint8_t get_free_spawn_spans(void);
+
 // Scroll the background to the left by one position. (Aliens aren't 
 // allowed to overlap the background so this may push some aliens 
 // along - or just remove an alien if it can't be pushed along.)
@@ -0,0 +1,49 @@
+/*
+ * idle.c
+ *
+ * Time spent asleep is measured with timer 1's counts (8 microseconds
+ * each). The busy percentage is the rest of the time since it was reset.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <stdint.h>
+
+#include "idle.h"
+#include "timer1.h"
+
+// Timer counts when the busy percentage was reset, and counts spent asleep
+// since then
+static uint32_t start_counts;
+static uint32_t idle_counts;
+
+void idle_until_interrupt(void) {
+	uint32_t sleep_start = get_current_counts();
+	
+	// Interrupts are turned back on just before we sleep. The instruction
+	// after sei() always runs before any interrupt, so an interrupt that
+	// is already waiting will wake us straight away rather than being
+	// missed.
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+	
+	idle_counts += get_current_counts() - sleep_start;
+}
+
+uint8_t get_busy_percent(void) {
+	uint32_t hundredth = (get_current_counts() - start_counts) / 100;
+	if(hundredth == 0) {
+		return 0;
+	}
+	uint32_t idle_percent = idle_counts / hundredth;
+	return (idle_percent >= 100) ? 0 : 100 - idle_percent;
+}
+
+void reset_busy_percent(void) {
+	start_counts = get_current_counts();
+	idle_counts = 0;
+}
@@ -0,0 +1,27 @@
+/*
+ * idle.h
+ *
+ * Puts the CPU into idle sleep when the program has nothing to do, and
+ * keeps track of how much of the time it is busy. In idle sleep the CPU
+ * stops but the timers, serial port, SPI, pin change interrupts and ADC
+ * keep going - any of their interrupts wakes it up again. To be woken at a
+ * particular time, set a wake up time first (see timer1.h). (Timer 0's
+ * seven segment display refresh also wakes it every millisecond.)
+ */
+
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include <stdint.h>
+
+// Sleep until the next interrupt. Must be called with interrupts turned
+// off (so nothing can arrive between deciding there is nothing to do and
+// going to sleep) - they are turned on again when this returns.
+void idle_until_interrupt(void);
+
+// Return the percentage of time the CPU has been awake since the last call
+// to reset_busy_percent() (or since the program started)
+uint8_t get_busy_percent(void);
+void reset_busy_percent(void);
+
+#endif /* IDLE_H_ */
@@ -0,0 +1,274 @@
+/*
+ * input.c
+ *
+ * See input.h for an overview. Button pushes and serial characters are
+ * timestamped by their interrupt handlers (with the low 16 bits of the
+ * clock) so the time of an event is when the input arrived, not when we
+ * got around to looking at it. A cursor key escape sequence takes the
+ * time of its first character. 
+ *
+ * A joystick move happens as soon as the joystick is pushed, and again
+ * and again while it is held - more often the further it is pushed. 
+ * Joystick events take the time the move fell due.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "input.h"
+#include "buttons.h"
+#include "serialio.h"
+#include "timer1.h"
+#include "ledmatrix.h"
+#include "joystick.h"
+
+// ASCII code for Escape character
+#define ESCAPE_CHAR 27
+
+// Time between joystick moves (in milliseconds) when it is only just
+// pushed past its deadzone, and when it is pushed all the way
+#define JOYSTICK_SLOWEST_REPEAT	250
+#define JOYSTICK_FASTEST_REPEAT	50
+
+// Used in action_subsystem[] for actions whose latency isn't measured
+#define NO_SUBSYSTEM	0xFF
+
+// Events waiting to be taken - a circular buffer of queue_length events
+// starting at queue[queue_head]
+#define INPUT_QUEUE_SIZE 8
+static InputEvent queue[INPUT_QUEUE_SIZE];
+static uint8_t queue_head;
+static uint8_t queue_length;
+
+// How far we are into a serial escape sequence (e.g. ESC [ D) and the time
+// the sequence started
+static uint8_t characters_into_escape_sequence;
+static uint32_t escape_sequence_time;
+
+// For each joystick axis, the direction it was pushed last time we looked
+// (1, -1 or 0 if it wasn't) and when it is next due to move if still held
+static int8_t joystick_direction[2];
+static uint32_t joystick_next_move[2];
+
+// The part of the display each action shows up on
+static const uint8_t action_subsystem[INPUT_NUM_ACTIONS] = {
+	LEDMATRIX_SUBSYSTEM_PLAYER,			// INPUT_LEFT
+	LEDMATRIX_SUBSYSTEM_PLAYER,			// INPUT_RIGHT
+	LEDMATRIX_SUBSYSTEM_PLAYER,			// INPUT_UP
+	LEDMATRIX_SUBSYSTEM_PLAYER,			// INPUT_DOWN
+	LEDMATRIX_SUBSYSTEM_PROJECTILES,	// INPUT_FIRE
+	NO_SUBSYSTEM,						// INPUT_DOUBLE_SPEED
+	NO_SUBSYSTEM,						// INPUT_NEW_GAME
+	NO_SUBSYSTEM,						// INPUT_PAUSE
+	NO_SUBSYSTEM,						// INPUT_STEERING
+	NO_SUBSYSTEM,						// INPUT_SHOW_SPI_USAGE
+	NO_SUBSYSTEM,						// INPUT_SHOW_LATENCY
+	NO_SUBSYSTEM						// INPUT_SHOW_CPU_USAGE
+};
+
+// Latency measurements in progress. Bit s of measuring is set if an event
+// that changed subsystem s is waiting for the change to be sent -
+// event_time[s] is the time of the earliest such event.
+static uint8_t measuring;
+static uint32_t event_time[LEDMATRIX_NUM_SUBSYSTEMS];
+static InputLatency latency = {0, 0, UINT16_MAX, 0};
+
+static void collect_input(void);
+static void check_joystick(void);
+static void add_serial_input(char c, uint32_t time);
+static void add_event(uint8_t action, uint32_t time);
+static uint32_t full_time(uint16_t time);
+
+///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
+
+void init_input(void) {
+	while(button_pushed() != NO_BUTTON_PUSHED) {
+		; // discard waiting button pushes
+	}
+	clear_serial_input_buffer();
+	queue_head = 0;
+	queue_length = 0;
+	characters_into_escape_sequence = 0;
+	joystick_direction[JOYSTICK_X] = 0;
+	joystick_direction[JOYSTICK_Y] = 0;
+	measuring = 0;
+}
+
+uint8_t input_next_event(InputEvent* event) {
+	collect_input();
+	if(queue_length == 0) {
+		return 0;
+	}
+	*event = queue[queue_head];
+	queue_head = (queue_head + 1) % INPUT_QUEUE_SIZE;
+	queue_length--;
+	return 1;
+}
+
+uint8_t input_waiting(void) {
+	collect_input();
+	return queue_length != 0;
+}
+
+void input_measure_latency(const InputEvent* event) {
+	uint8_t subsystem = action_subsystem[event->action];
+
+	if(subsystem == NO_SUBSYSTEM) {
+		return;
+	}
+	if(measuring & (1 << subsystem)) {
+		if(event->time < event_time[subsystem]) {
+			event_time[subsystem] = event->time;
+		}
+		return;
+	}
+	measuring |= (1 << subsystem);
+	event_time[subsystem] = event->time;
+}
+
+void input_check_sent(void) {
+	if(!measuring || !ledmatrix_all_sent()) {
+		return;
+	}
+	uint32_t now = get_current_time();
+
+	for(uint8_t subsystem = 0; measuring; subsystem++) {
+		if(!(measuring & (1 << subsystem))) {
+			continue;
+		}
+		measuring &= ~(1 << subsystem);
+		uint32_t elapsed = now - event_time[subsystem];
+		uint16_t sample = (elapsed > UINT16_MAX) ? UINT16_MAX : elapsed;
+		latency.count++;
+		latency.total += sample;
+		if(sample < latency.min) {
+			latency.min = sample;
+		}
+		if(sample > latency.max) {
+			latency.max = sample;
+		}
+	}
+}
+
+void input_get_latency(InputLatency* result) {
+	*result = latency;
+}
+
+///////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+// Move waiting button pushes and serial characters into the event queue
+// (as long as there is room for them)
+static void collect_input(void) {
+	static const uint8_t button_action[4] = {
+		INPUT_DOWN, INPUT_UP, INPUT_DOUBLE_SPEED, INPUT_FIRE
+	};
+	uint16_t time;
+	int8_t button;
+
+	check_joystick();
+	while(queue_length < INPUT_QUEUE_SIZE) {
+		button = button_pushed_at(&time);
+		if(button != NO_BUTTON_PUSHED) {
+			add_event(button_action[(uint8_t)button], full_time(time));
+		} else if(serial_input_available()) {
+			time = serial_input_time();
+			add_serial_input(fgetc(stdin), full_time(time));
+		} else {
+			break;
+		}
+	}
+}
+
+// Add joystick moves that have fallen due
+static void check_joystick(void) {
+	// Actions for each axis when pushed in the direction of increasing or
+	// decreasing ADC readings
+	static const uint8_t increasing_action[2] = { INPUT_LEFT, INPUT_UP };
+	static const uint8_t decreasing_action[2] = { INPUT_RIGHT, INPUT_DOWN };
+	uint32_t now = get_current_time();
+
+	for(uint8_t axis = JOYSTICK_X; axis <= JOYSTICK_Y; axis++) {
+		int16_t deflection = joystick_deflection(axis);
+		int8_t direction = (deflection > 0) - (deflection < 0);
+		uint32_t due;
+
+		if(direction == 0) {
+			joystick_direction[axis] = 0;
+			continue;
+		}
+		if(direction != joystick_direction[axis]) {
+			// Just pushed - move straight away
+			due = now;
+		} else if((int32_t)(now - joystick_next_move[axis]) >= 0) {
+			// Held and the next move is due
+			due = joystick_next_move[axis];
+		} else {
+			continue;
+		}
+
+		uint16_t repeat = JOYSTICK_SLOWEST_REPEAT - 
+				(uint32_t)(JOYSTICK_SLOWEST_REPEAT - JOYSTICK_FASTEST_REPEAT) * 
+				(direction * deflection) / JOYSTICK_FULL;
+		joystick_next_move[axis] = due + repeat;
+		if((int32_t)(now - joystick_next_move[axis]) >= 0) {
+			// We've fallen a whole move behind - don't try to catch up
+			joystick_next_move[axis] = now + repeat;
+		}
+		joystick_direction[axis] = direction;
+		add_event((direction > 0) ? increasing_action[axis] : decreasing_action[axis], due);
+	}
+}
+
+// Handle a serial character. Cursor keys arrive as an escape sequence,
+// e.g. ESC [ D is the left cursor key, so we can't do anything with those
+// until we get the third character.
+static void add_serial_input(char c, uint32_t time) {
+	if(characters_into_escape_sequence == 0 && c == ESCAPE_CHAR) {
+		characters_into_escape_sequence++;
+		escape_sequence_time = time;
+		return;
+	} else if(characters_into_escape_sequence == 1 && c == '[') {
+		characters_into_escape_sequence++;
+		return;
+	} else if(characters_into_escape_sequence == 2) {
+		characters_into_escape_sequence = 0;
+		switch(c) {
+			case 'A': add_event(INPUT_UP, escape_sequence_time); break;
+			case 'B': add_event(INPUT_DOWN, escape_sequence_time); break;
+			case 'C': add_event(INPUT_RIGHT, escape_sequence_time); break;
+			case 'D': add_event(INPUT_LEFT, escape_sequence_time); break;
+		}
+		return;
+	}
+
+	// Character was not part of an escape sequence (or we received an
+	// invalid second character in the sequence)
+	characters_into_escape_sequence = 0;
+	switch(c) {
+		case ' ': add_event(INPUT_FIRE, time); break;
+		case 'n': case 'N': add_event(INPUT_NEW_GAME, time); break;
+		case 'p': case 'P': add_event(INPUT_PAUSE, time); break;
+		case 'a': case 'A': add_event(INPUT_STEERING, time); break;
+		case 'b': case 'B': add_event(INPUT_SHOW_SPI_USAGE, time); break;
+		case 'l': case 'L': add_event(INPUT_SHOW_LATENCY, time); break;
+		case 'u': case 'U': add_event(INPUT_SHOW_CPU_USAGE, time); break;
+	}
+}
+
+// Add an event to the end of the queue. It is discarded if the queue is
+// full.
+static void add_event(uint8_t action, uint32_t time) {
+	if(queue_length < INPUT_QUEUE_SIZE) {
+		uint8_t tail = (queue_head + queue_length) % INPUT_QUEUE_SIZE;
+		queue[tail].action = action;
+		queue[tail].time = time;
+		queue_length++;
+	}
+}
+
+// Turn a time recorded as the low 16 bits of the clock tick count back into
+// a full clock tick count. The time must be in the last 65 seconds.
+static uint32_t full_time(uint16_t time) {
+	uint32_t now = get_current_time();
+	return now - (uint16_t)((uint16_t)now - time);
+}
@@ -0,0 +1,78 @@
+/*
+ * input.h
+ *
+ * Collects the player's input - button pushes, serial input (including
+ * cursor key escape sequences) and joystick movements - into a single
+ * queue of events. Each event is the game action it maps to and the time
+ * the input happened. The game should take every waiting event each time
+ * through its loop.
+ *
+ * We also measure how long it takes for input to show up on the LED
+ * matrix: the time from an event to when the change it made to the
+ * display (the player for moves, projectiles for firing) has been sent
+ * over the SPI link. The game says which events changed the display -
+ * e.g. a move into a wall changes nothing and isn't measured.
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stdint.h>
+
+typedef enum {
+	INPUT_LEFT,
+	INPUT_RIGHT,
+	INPUT_UP,
+	INPUT_DOWN,
+	INPUT_FIRE,
+	INPUT_DOUBLE_SPEED,
+	INPUT_NEW_GAME,
+	INPUT_PAUSE,
+	INPUT_STEERING,			// toggle aliens steering towards the player
+	INPUT_SHOW_SPI_USAGE,
+	INPUT_SHOW_LATENCY,
+	INPUT_SHOW_CPU_USAGE,
+	INPUT_NUM_ACTIONS
+} InputAction;
+
+typedef struct {
+	uint8_t action;		// an InputAction
+	uint32_t time;		// get_current_time() when the input happened
+} InputEvent;
+
+// Input to LED matrix latency (in milliseconds) over count events
+typedef struct {
+	uint32_t count;
+	uint32_t total;
+	uint16_t min;
+	uint16_t max;
+} InputLatency;
+
+// Throw away any waiting input (button pushes and serial input too) and
+// any latency measurements in progress
+void init_input(void);
+
+// Get the next input event. Returns 1 and fills in *event if there is
+// one, 0 if there is no input waiting. Button pushes, serial input and
+// joystick moves are collected as they are needed.
+uint8_t input_next_event(InputEvent* event);
+
+// Return 1 if there is an input event waiting, 0 otherwise
+uint8_t input_waiting(void);
+
+// Start measuring the latency of an event the game has just acted on.
+// Should only be called for events that changed the display. Events
+// changing the same part of the display before it is sent are measured
+// once, from the earliest.
+void input_measure_latency(const InputEvent* event);
+
+// Finish the latency measurements in progress if everything drawn has now
+// been sent to the LED matrix (see ledmatrix_all_sent()). Should be
+// called often - in particular whenever the CPU wakes - so the time is
+// taken as soon as the link has finished.
+void input_check_sent(void);
+
+// Get the latency measured so far
+void input_get_latency(InputLatency* latency);
+
+#endif /* INPUT_H_ */
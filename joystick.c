@@ -0,0 +1,227 @@
+/*
+ * joystick.c
+ *
+ * See joystick.h for an overview. Conversions are started automatically
+ * by timer 0's compare match (every millisecond), so the ADC runs without
+ * any help from the main loop and doesn't wake the CPU any more often
+ * than timer 0 already does. Each conversion complete interrupt adds the
+ * reading to its axis' total and switches to the other axis. Every
+ * JOYSTICK_OVERSAMPLE readings of an axis, their total is blended into
+ * that axis' smoothed value.
+ *
+ * Values below are kept as totals of JOYSTICK_OVERSAMPLE readings (i.e. in
+ * units of 1/JOYSTICK_OVERSAMPLE of an ADC step) for extra precision.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <stdint.h>
+
+#include "joystick.h"
+
+// Readings of each axis averaged together, and how much each new average
+// counts towards the smoothed value (1/JOYSTICK_SMOOTHING of it)
+#define JOYSTICK_OVERSAMPLE	4
+#define JOYSTICK_SMOOTHING	2
+
+// Largest total of JOYSTICK_OVERSAMPLE readings
+#define MAX_VALUE	(1023 * JOYSTICK_OVERSAMPLE)
+
+// Centre and deadzone used until the joystick is calibrated - the same as
+// the old fixed thresholds of 300 and 700
+#define DEFAULT_CENTRE		(500 * JOYSTICK_OVERSAMPLE)
+#define DEFAULT_DEADZONE	(200 * JOYSTICK_OVERSAMPLE)
+
+// Calibration watches this many smoothed values of each axis. The deadzone
+// is made this much (in ADC steps) bigger than the movement seen at rest,
+// but no bigger than MAX_DEADZONE.
+#define CALIBRATION_READINGS	32
+#define DEADZONE_MARGIN			(50 * JOYSTICK_OVERSAMPLE)
+#define MAX_DEADZONE			(400 * JOYSTICK_OVERSAMPLE)
+
+// Calibration as saved in EEPROM. check is the bitwise inverse of the
+// other bytes XORed together, so that blank (or old) EEPROM contents are
+// not mistaken for a calibration.
+#define SETTINGS_MAGIC 0xA5
+typedef struct {
+	uint8_t magic;
+	uint16_t centre[2];
+	uint16_t deadzone[2];
+	uint8_t check;
+} JoystickSettings;
+
+static JoystickSettings EEMEM saved_settings;
+
+// The calibration in use
+static uint16_t centre[2] = { DEFAULT_CENTRE, DEFAULT_CENTRE };
+static uint16_t deadzone[2] = { DEFAULT_DEADZONE, DEFAULT_DEADZONE };
+
+// Totals of the readings so far of each axis (and how many there are), and
+// the smoothed value of each axis. These are updated by the interrupt
+// handler.
+static volatile uint16_t reading_total[2];
+static volatile uint8_t readings[2];
+static volatile uint16_t smoothed[2] = { DEFAULT_CENTRE, DEFAULT_CENTRE };
+
+// Calibration in progress (if calibrating is 1) - the number of smoothed
+// values still to be seen for each axis, and the smallest and largest seen
+// so far
+static uint8_t calibrating;
+static volatile uint8_t calibration_left[2];
+static volatile uint16_t calibration_min[2];
+static volatile uint16_t calibration_max[2];
+
+static uint8_t settings_check(const JoystickSettings* settings);
+static uint16_t read_smoothed(uint8_t axis);
+
+///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
+
+void init_joystick(void) {
+	JoystickSettings settings;
+	eeprom_read_block(&settings, &saved_settings, sizeof(settings));
+	if(settings.magic == SETTINGS_MAGIC &&
+			settings.check == settings_check(&settings)) {
+		for(uint8_t axis = 0; axis < 2; axis++) {
+			if(settings.centre[axis] <= MAX_VALUE &&
+					settings.deadzone[axis] <= MAX_DEADZONE) {
+				centre[axis] = settings.centre[axis];
+				deadzone[axis] = settings.deadzone[axis];
+				smoothed[axis] = centre[axis];
+			}
+		}
+	}
+
+	// Start with the x axis. Conversions are started by timer 0 compare
+	// match A (auto trigger source 3) with the ADC clock at 125kHz (system
+	// clock divided by 64).
+	ADMUX = (1<<REFS0) | JOYSTICK_X;
+	ADCSRB = (1<<ADTS1) | (1<<ADTS0);
+	ADCSRA = (1<<ADEN) | (1<<ADATE) | (1<<ADIE) | (1<<ADPS2) | (1<<ADPS1);
+}
+
+int16_t joystick_deflection(uint8_t axis) {
+	int16_t offset = (int16_t)read_smoothed(axis) - (int16_t)centre[axis];
+	int16_t distance = (offset < 0) ? -offset : offset;
+
+	if(distance <= (int16_t)deadzone[axis]) {
+		return 0;
+	}
+
+	// Scale the distance past the deadzone by how far the joystick can go
+	// past the deadzone in that direction
+	int16_t travel;
+	if(offset > 0) {
+		travel = MAX_VALUE - centre[axis] - deadzone[axis];
+	} else {
+		travel = centre[axis] - deadzone[axis];
+	}
+	int16_t deflection = JOYSTICK_FULL;
+	if(distance - (int16_t)deadzone[axis] < travel) {
+		deflection = (int32_t)(distance - deadzone[axis]) * JOYSTICK_FULL / travel;
+		if(deflection == 0) {
+			deflection = 1;
+		}
+	}
+	return (offset < 0) ? -deflection : deflection;
+}
+
+void joystick_start_calibration(void) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	for(uint8_t axis = 0; axis < 2; axis++) {
+		calibration_min[axis] = MAX_VALUE;
+		calibration_max[axis] = 0;
+		calibration_left[axis] = CALIBRATION_READINGS;
+	}
+	calibrating = 1;
+	if(interrupts_were_enabled) {
+		sei();
+	}
+}
+
+uint8_t joystick_finish_calibration(void) {
+	JoystickSettings settings;
+
+	if(!calibrating || calibration_left[JOYSTICK_X] || 
+			calibration_left[JOYSTICK_Y]) {
+		return 0;
+	}
+	calibrating = 0;
+	for(uint8_t axis = 0; axis < 2; axis++) {
+		uint16_t spread = calibration_max[axis] - calibration_min[axis];
+		centre[axis] = calibration_min[axis] + spread / 2;
+		deadzone[axis] = spread / 2 + DEADZONE_MARGIN;
+		if(deadzone[axis] > MAX_DEADZONE) {
+			deadzone[axis] = MAX_DEADZONE;
+		}
+		settings.centre[axis] = centre[axis];
+		settings.deadzone[axis] = deadzone[axis];
+	}
+
+	settings.magic = SETTINGS_MAGIC;
+	settings.check = settings_check(&settings);
+	eeprom_update_block(&settings, &saved_settings, sizeof(settings));
+	return 1;
+}
+
+uint16_t joystick_get_centre(uint8_t axis) {
+	return centre[axis] / JOYSTICK_OVERSAMPLE;
+}
+
+uint16_t joystick_get_deadzone(uint8_t axis) {
+	return deadzone[axis] / JOYSTICK_OVERSAMPLE;
+}
+
+///////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+static uint8_t settings_check(const JoystickSettings* settings) {
+	uint8_t check = settings->magic;
+	for(uint8_t axis = 0; axis < 2; axis++) {
+		check ^= (settings->centre[axis] >> 8) ^ settings->centre[axis];
+		check ^= (settings->deadzone[axis] >> 8) ^ settings->deadzone[axis];
+	}
+	return ~check;
+}
+
+// Read an axis' smoothed value (which the interrupt handler may be in the
+// middle of changing)
+static uint16_t read_smoothed(uint8_t axis) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	uint16_t value = smoothed[axis];
+	if(interrupts_were_enabled) {
+		sei();
+	}
+	return value;
+}
+
+// Interrupt handler for an ADC conversion completing
+ISR(ADC_vect) {
+	uint8_t axis = ADMUX & 1;
+
+	// Read the next axis next time (the next conversion won't start until
+	// timer 0's next compare match)
+	ADMUX ^= 1;
+
+	reading_total[axis] += ADC;
+	if(++readings[axis] < JOYSTICK_OVERSAMPLE) {
+		return;
+	}
+
+	// Move the smoothed value part of the way towards the new average
+	int16_t change = (int16_t)reading_total[axis] - (int16_t)smoothed[axis];
+	smoothed[axis] += change / JOYSTICK_SMOOTHING;
+	reading_total[axis] = 0;
+	readings[axis] = 0;
+
+	if(calibration_left[axis]) {
+		if(smoothed[axis] < calibration_min[axis]) {
+			calibration_min[axis] = smoothed[axis];
+		}
+		if(smoothed[axis] > calibration_max[axis]) {
+			calibration_max[axis] = smoothed[axis];
+		}
+		calibration_left[axis]--;
+	}
+}
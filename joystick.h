@@ -0,0 +1,48 @@
+/*
+ * joystick.h
+ *
+ * Reads the joystick (x axis on ADC0, y axis on ADC1) in the background.
+ * The ADC interrupt handler takes a reading of each axis in turn, averages
+ * several readings of each and smooths the result, so the position can be
+ * read at any time without waiting for the ADC.
+ *
+ * Positions within a deadzone around the centre count as the joystick not
+ * being pushed. The centre and deadzone of each axis can be calibrated
+ * with the joystick at rest and are saved in EEPROM.
+ */
+
+#ifndef JOYSTICK_H_
+#define JOYSTICK_H_
+
+#include <stdint.h>
+
+#define JOYSTICK_X	0
+#define JOYSTICK_Y	1
+
+// How far the joystick is pushed when it is pushed all the way
+#define JOYSTICK_FULL	255
+
+// Set up the ADC and start reading the joystick, using the saved
+// calibration (if there is one). Timer 0 must be set up as the ADC is
+// started by its interrupts (see timer0.h).
+void init_joystick(void);
+
+// Return how far the joystick is pushed along the given axis, from
+// -JOYSTICK_FULL to JOYSTICK_FULL (0 within the deadzone). Positive is
+// the direction in which the ADC reading increases.
+int16_t joystick_deflection(uint8_t axis);
+
+// Start calibrating. The joystick should be left at rest until
+// joystick_finish_calibration() returns 1.
+void joystick_start_calibration(void);
+
+// If a calibration has been started and has taken enough readings, work
+// out and save the new centre and deadzone and return 1. Returns 0
+// otherwise.
+uint8_t joystick_finish_calibration(void);
+
+// Return the centre and deadzone of the given axis (in ADC units)
+uint16_t joystick_get_centre(uint8_t axis);
+uint16_t joystick_get_deadzone(uint8_t axis);
+
+#endif /* JOYSTICK_H_ */
@@ -4,12 +4,30 @@
  * Author: Peter Sutton
  * 
  * See the LED matrix Reference for details of the SPI commands used.
+ *
+ * Drawing functions do not talk to the matrix directly. They update a
+ * shadow copy of the display (shadow_frame) and we keep track of which
+ * pixels differ from what the matrix is currently showing (matrix_frame).
+ * ledmatrix_flush() then sends the differences using whichever
+ * combination of commands needs the fewest SPI bytes. Pixels which are
+ * erased and redrawn in the same tick (or set to the colour they
+ * already have) are never sent at all.
+ *
+ * Commands are queued for the SPI interrupt handler rather than sent
+ * directly, so drawing never has to wait for the matrix. Pixels drawn with
+ * ledmatrix_update_pixel_urgent() go in the urgent queue, which jumps
+ * ahead of large updates already waiting in the bulk queue. If a queue is
+ * full, changes are simply left pending until the next flush.
  */ 
 
 #include <avr/io.h>
+#include <string.h>
 #include "ledmatrix.h"
 #include "spi.h"
 
+#define F_CPU 8000000L
+#include <util/delay.h>
+
 #define CMD_UPDATE_ALL 0x00
 #define CMD_UPDATE_PIXEL 0x01
 #define CMD_UPDATE_ROW 0x02
@@ -17,6 +35,70 @@
 #define CMD_SHIFT_DISPLAY 0x04
 #define CMD_CLEAR_SCREEN 0x0F
 
+// Number of SPI bytes needed for each command
+#define BYTES_UPDATE_ALL	(1 + MATRIX_NUM_COLUMNS * MATRIX_NUM_ROWS)
+#define BYTES_UPDATE_PIXEL	3
+#define BYTES_UPDATE_ROW	(2 + MATRIX_NUM_COLUMNS)
+#define BYTES_UPDATE_COL	(2 + MATRIX_NUM_ROWS)
+#define BYTES_SHIFT_DISPLAY	2
+#define BYTES_CLEAR_SCREEN	1
+
+// What we want the display to show, and what it is actually showing
+static MatrixData shadow_frame;
+static MatrixData matrix_frame;
+
+// One 16 bit mask per row - bit x is set if pixel (x,y) in the shadow
+// frame differs from the matrix frame (i.e. needs to be sent)
+static uint16_t dirty_rows[MATRIX_NUM_ROWS];
+
+// Masks of pixels last drawn with ledmatrix_update_pixel_urgent(), and of
+// pixels covered by commands put in the bulk queue since it was last idle.
+// An urgent pixel may only skip the bulk queue if nothing in that queue
+// would overwrite it afterwards.
+static uint16_t urgent_rows[MATRIX_NUM_ROWS];
+static uint16_t bulk_pending_rows[MATRIX_NUM_ROWS];
+
+// Byte counts for the frame being built: what it would have cost to send
+// every request straight away, and what we actually sent. A frame isn't
+// finished until a flush has sent everything. Also the total saved by
+// finished frames, and the number of those frames.
+static uint16_t frame_bytes_requested;
+static uint16_t frame_bytes_sent;
+static uint32_t total_bytes_saved;
+static uint32_t saved_frame_count;
+
+// The subsystem that owns each pixel - two pixels (4 bits each) per byte,
+// indexed by y*MATRIX_NUM_COLUMNS + x - and the subsystem currently drawing
+static uint8_t pixel_owner[MATRIX_NUM_COLUMNS * MATRIX_NUM_ROWS / 2];
+static LedmatrixSubsystem current_subsystem;
+
+// SPI usage so far, and bytes sent by each subsystem this frame
+static LedmatrixUsage subsystem_usage[LEDMATRIX_NUM_SUBSYSTEMS];
+static LedmatrixUsage command_usage[LEDMATRIX_NUM_COMMANDS];
+static LedmatrixUsage total_usage;
+static uint32_t frame_count;
+static uint16_t subsystem_frame_bytes[LEDMATRIX_NUM_SUBSYSTEMS];
+
+// Helper functions
+static void set_shadow_pixel(uint8_t x, uint8_t y, PixelColour pixel);
+static uint8_t owner_of(uint8_t x, uint8_t y);
+static void set_owner(uint8_t x, uint8_t y, LedmatrixSubsystem subsystem);
+static void record_command(LedmatrixCommand command, LedmatrixSubsystem subsystem);
+static void end_frame_usage(void);
+static uint8_t first_dirty_x(uint8_t y);
+static uint8_t count_dirty_in_row(uint8_t y);
+static uint8_t count_dirty_in_column(uint8_t x);
+static void wait_for_bulk_queue_space(uint8_t length);
+static uint8_t send_all(void);
+static uint8_t send_row(uint8_t y);
+static uint8_t send_column(uint8_t x);
+static uint8_t send_pixel(uint8_t x, uint8_t y, uint8_t queue);
+static void send_shift(uint8_t direction);
+static void shift_frame(MatrixData frame, int8_t dx, int8_t dy);
+static void shift_owners(int8_t dx, int8_t dy);
+static void find_dirty_pixels(void);
+static void wait_for_gap(uint8_t microseconds);
+
 void ledmatrix_setup(void) {
 	// Setup SPI - we divide the clock by 128.
 	// (This speed guarantees the SPI buffer will never overflow on
@@ -24,13 +106,60 @@ void ledmatrix_setup(void) {
 	spi_setup_master(128);
 }
 
-void ledmatrix_update_all(MatrixData data) {
+void ledmatrix_set_link_speed(uint8_t clockdivider, uint8_t command_gap) {
+	// Let everything already queued go at the old speed
+	while(!spi_queue_is_idle(SPI_QUEUE_BULK) || !spi_queue_is_idle(SPI_QUEUE_URGENT)) {
+		; // wait
+	}
+	spi_setup_master(clockdivider);
+	spi_set_command_gap(command_gap);
+}
+
+void ledmatrix_show_link_test(uint8_t command_gap, PixelColour border, 
+		PixelColour fill) {
+	// The whole display in one command - the most the matrix has to
+	// receive at once
 	(void)spi_send_byte(CMD_UPDATE_ALL);
+	for(uint8_t i = 0; i < MATRIX_NUM_COLUMNS * MATRIX_NUM_ROWS; i++) {
+		(void)spi_send_byte(COLOUR_ORANGE);
+	}
+	wait_for_gap(command_gap);
+	
+	// Every row, then every pixel, as separate commands sent back to back
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		(void)spi_send_byte(CMD_UPDATE_ROW);
+		(void)spi_send_byte(y);
+		for(uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+			(void)spi_send_byte(COLOUR_YELLOW);
+		}
+		wait_for_gap(command_gap);
+	}
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		for(uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+			PixelColour pixel = fill;
+			if(x == 0 || y == 0 || x == MATRIX_NUM_COLUMNS - 1 || 
+					y == MATRIX_NUM_ROWS - 1) {
+				pixel = border;
+			}
+			(void)spi_send_byte(CMD_UPDATE_PIXEL);
+			(void)spi_send_byte((y<<4) | x);
+			(void)spi_send_byte(pixel);
+			matrix_frame[x][y] = pixel;
+			wait_for_gap(command_gap);
+		}
+	}
+	
+	// The next flush puts back what should be displayed
+	find_dirty_pixels();
+}
+
+void ledmatrix_update_all(MatrixData data) {
 	for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
 		for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
-			(void)spi_send_byte(data[x][y]);
+			set_shadow_pixel(x, y, data[x][y]);
 		}
 	}
+	frame_bytes_requested += BYTES_UPDATE_ALL;
 }
 
 void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
@@ -38,9 +167,19 @@ void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
 		// Position isn't valid - we ignore the request.
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_PIXEL);
-	(void)spi_send_byte( ((y & 0x07)<<4) | (x & 0x0F));
-	(void)spi_send_byte(pixel);
+	set_shadow_pixel(x, y, pixel);
+	urgent_rows[y] &= ~(1U << x);
+	frame_bytes_requested += BYTES_UPDATE_PIXEL;
+}
+
+void ledmatrix_update_pixel_urgent(uint8_t x, uint8_t y, PixelColour pixel) {
+	if(x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS) {
+		// Position isn't valid - we ignore the request.
+		return;
+	}
+	set_shadow_pixel(x, y, pixel);
+	urgent_rows[y] |= (1U << x);
+	frame_bytes_requested += BYTES_UPDATE_PIXEL;
 }
 
 void ledmatrix_update_row(uint8_t y, MatrixRow row) {
@@ -48,11 +187,10 @@ void ledmatrix_update_row(uint8_t y, MatrixRow row) {
 		// y value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_ROW);
-	(void)spi_send_byte(y & 0x07);	// row number
 	for(uint8_t x = 0; x<MATRIX_NUM_COLUMNS; x++) {
-		(void)spi_send_byte(row[x]);
+		set_shadow_pixel(x, y, row[x]);
 	}
+	frame_bytes_requested += BYTES_UPDATE_ROW;
 }
 
 void ledmatrix_update_column(uint8_t x, MatrixColumn col) {
@@ -60,35 +198,166 @@ void ledmatrix_update_column(uint8_t x, MatrixColumn col) {
 		// x value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_COL);
-	(void)spi_send_byte(x & 0x0F); // column number
 	for(uint8_t y = 0; y<MATRIX_NUM_ROWS; y++) {
-		(void)spi_send_byte(col[y]);
+		set_shadow_pixel(x, y, col[y]);
 	}
+	frame_bytes_requested += BYTES_UPDATE_COL;
 }
 
 void ledmatrix_shift_display_left(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x02);
+	send_shift(0x02);
 }
 
 void ledmatrix_shift_display_right(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x01);
+	send_shift(0x01);
 }
 
 void ledmatrix_shift_display_up(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x08);
+	send_shift(0x08);
 }
 
 void ledmatrix_shift_display_down(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x04);
+	send_shift(0x04);
 }
 
 void ledmatrix_clear(void) {
-	(void)spi_send_byte(CMD_CLEAR_SCREEN);
+	// Clearing is cheaper than anything we could flush, so pending
+	// changes are simply discarded and the command is sent straight away.
+	wait_for_bulk_queue_space(BYTES_CLEAR_SCREEN);
+	(void)spi_queue_begin(SPI_QUEUE_BULK, BYTES_CLEAR_SCREEN);
+	spi_queue_byte(CMD_CLEAR_SCREEN);
+	spi_queue_end();
+	record_command(LEDMATRIX_COMMAND_CLEAR, current_subsystem);
+	for(uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		set_matrix_column_to_colour(shadow_frame[x], COLOUR_BLACK);
+		set_matrix_column_to_colour(matrix_frame[x], COLOUR_BLACK);
+	}
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		dirty_rows[y] = 0;
+		bulk_pending_rows[y] = 0xFFFF;
+	}
+	frame_bytes_requested += BYTES_CLEAR_SCREEN;
+}
+
+void ledmatrix_flush(void) {
+	// Once the bulk queue has emptied nothing in it can overwrite an
+	// urgent pixel
+	uint8_t bulk_idle = spi_queue_is_idle(SPI_QUEUE_BULK);
+	uint8_t total_dirty = 0;
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		if(bulk_idle) {
+			bulk_pending_rows[y] = 0;
+		}
+		total_dirty += count_dirty_in_row(y);
+	}
+	
+	// Urgent pixels go first, each as its own command.
+	uint8_t queue_has_room = 1;
+	for(uint8_t y = 0; queue_has_room && y < MATRIX_NUM_ROWS; y++) {
+		uint16_t urgent = dirty_rows[y] & urgent_rows[y] & ~bulk_pending_rows[y];
+		for(uint8_t x = 0; urgent && x < MATRIX_NUM_COLUMNS; x++) {
+			if(urgent & (1U << x)) {
+				if(!send_pixel(x, y, SPI_QUEUE_URGENT)) {
+					queue_has_room = 0;
+					break;
+				}
+				urgent &= ~(1U << x);
+				total_dirty--;
+			}
+		}
+	}
+	
+	if(total_dirty * BYTES_UPDATE_PIXEL >= BYTES_UPDATE_ALL) {
+		// Most of the display has changed - send the lot
+		queue_has_room = send_all();
+	} else if(total_dirty) {
+		// Columns with enough changed pixels are sent as a column, then
+		// rows with enough of what remains are sent as a row. Anything
+		// left over is sent pixel by pixel. We stop as soon as the bulk
+		// queue fills up - the rest will be sent next time.
+		queue_has_room = 1;
+		for(uint8_t x = 0; queue_has_room && x < MATRIX_NUM_COLUMNS; x++) {
+			if(count_dirty_in_column(x) * BYTES_UPDATE_PIXEL > BYTES_UPDATE_COL) {
+				queue_has_room = send_column(x);
+			}
+		}
+		for(uint8_t y = 0; queue_has_room && y < MATRIX_NUM_ROWS; y++) {
+			if(count_dirty_in_row(y) * BYTES_UPDATE_PIXEL > BYTES_UPDATE_ROW) {
+				queue_has_room = send_row(y);
+			}
+		}
+		for(uint8_t y = 0; queue_has_room && y < MATRIX_NUM_ROWS; y++) {
+			for(uint8_t x = 0; queue_has_room && dirty_rows[y] && x < MATRIX_NUM_COLUMNS; x++) {
+				if(dirty_rows[y] & (1U << x)) {
+					queue_has_room = send_pixel(x, y, SPI_QUEUE_BULK);
+				}
+			}
+		}
+	}
+	
+	// If we stopped early, the rest of this frame's requests go out next
+	// time and the saving is worked out then
+	if(frame_bytes_requested && !ledmatrix_has_unsent()) {
+		if(frame_bytes_requested > frame_bytes_sent) {
+			total_bytes_saved += frame_bytes_requested - frame_bytes_sent;
+		}
+		saved_frame_count++;
+		frame_bytes_requested = 0;
+		frame_bytes_sent = 0;
+	}
+	end_frame_usage();
+}
+
+uint8_t ledmatrix_has_unsent(void) {
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		if(dirty_rows[y]) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint8_t ledmatrix_all_sent(void) {
+	return !ledmatrix_has_unsent() && spi_queue_is_idle(SPI_QUEUE_URGENT) &&
+			spi_queue_is_idle(SPI_QUEUE_BULK);
+}
+
+void ledmatrix_count_merged_pixels(uint16_t pixels) {
+	frame_bytes_requested += pixels * BYTES_UPDATE_PIXEL;
+}
+
+void ledmatrix_get_bytes_saved(uint32_t* bytes, uint32_t* frames) {
+	*bytes = total_bytes_saved;
+	*frames = saved_frame_count;
+}
+
+void ledmatrix_set_subsystem(LedmatrixSubsystem subsystem) {
+	current_subsystem = subsystem;
+}
+
+void ledmatrix_get_subsystem_usage(LedmatrixSubsystem subsystem, LedmatrixUsage* usage) {
+	*usage = subsystem_usage[subsystem];
+}
+
+void ledmatrix_get_command_usage(LedmatrixCommand command, LedmatrixUsage* usage) {
+	*usage = command_usage[command];
+}
+
+void ledmatrix_get_total_usage(LedmatrixUsage* usage) {
+	*usage = total_usage;
+}
+
+uint32_t ledmatrix_get_frame_count(void) {
+	return frame_count;
+}
+
+void ledmatrix_reset_usage(void) {
+	memset(subsystem_usage, 0, sizeof(subsystem_usage));
+	memset(command_usage, 0, sizeof(command_usage));
+	memset(&total_usage, 0, sizeof(total_usage));
+	frame_count = 0;
+	total_bytes_saved = 0;
+	saved_frame_count = 0;
 }
 
 void copy_matrix_column(MatrixColumn from, MatrixColumn to) {
@@ -114,3 +383,292 @@ void set_matrix_row_to_colour(MatrixRow matrix_row, PixelColour colour) {
 		matrix_row[column] = colour;
 	}
 }
+
+/////////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+// Record the colour we want for a pixel. The pixel only needs to be sent
+// if this is different to what the matrix is currently showing.
+static void set_shadow_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
+	shadow_frame[x][y] = pixel;
+	if(pixel != COLOUR_BLACK) {
+		set_owner(x, y, current_subsystem);
+	}
+	if(pixel == matrix_frame[x][y]) {
+		dirty_rows[y] &= ~(1U << x);
+	} else {
+		dirty_rows[y] |= (1U << x);
+	}
+}
+
+static uint8_t owner_of(uint8_t x, uint8_t y) {
+	uint8_t index = y * MATRIX_NUM_COLUMNS + x;
+	if(index & 1) {
+		return pixel_owner[index >> 1] >> 4;
+	} else {
+		return pixel_owner[index >> 1] & 0x0F;
+	}
+}
+
+static void set_owner(uint8_t x, uint8_t y, LedmatrixSubsystem subsystem) {
+	uint8_t index = y * MATRIX_NUM_COLUMNS + x;
+	if(index & 1) {
+		pixel_owner[index >> 1] = (pixel_owner[index >> 1] & 0x0F) | (subsystem << 4);
+	} else {
+		pixel_owner[index >> 1] = (pixel_owner[index >> 1] & 0xF0) | subsystem;
+	}
+}
+
+// Return the leftmost changed pixel in row y (which must have one)
+static uint8_t first_dirty_x(uint8_t y) {
+	uint8_t x = 0;
+	while(!(dirty_rows[y] & (1U << x))) {
+		x++;
+	}
+	return x;
+}
+
+// Number of bytes for each type of command (in LedmatrixCommand order)
+static const uint8_t command_bytes[LEDMATRIX_NUM_COMMANDS] = {
+	BYTES_UPDATE_ALL, BYTES_UPDATE_PIXEL, BYTES_UPDATE_ROW,
+	BYTES_UPDATE_COL, BYTES_SHIFT_DISPLAY, BYTES_CLEAR_SCREEN
+};
+
+// Record that a command has been sent on behalf of the given subsystem
+static void record_command(LedmatrixCommand command, LedmatrixSubsystem subsystem) {
+	uint8_t bytes = command_bytes[command];
+	subsystem_usage[subsystem].bytes += bytes;
+	subsystem_usage[subsystem].commands++;
+	subsystem_frame_bytes[subsystem] += bytes;
+	command_usage[command].bytes += bytes;
+	command_usage[command].commands++;
+	total_usage.bytes += bytes;
+	total_usage.commands++;
+	frame_bytes_sent += bytes;
+}
+
+// Update the peak usage figures at the end of a frame and start a new one.
+// (Only the per subsystem and overall peaks are kept - a frame usually
+// sends several types of command.)
+static void end_frame_usage(void) {
+	uint16_t frame_bytes = 0;
+	for(uint8_t subsystem = 0; subsystem < LEDMATRIX_NUM_SUBSYSTEMS; subsystem++) {
+		uint16_t bytes = subsystem_frame_bytes[subsystem];
+		if(bytes > subsystem_usage[subsystem].peak_frame_bytes) {
+			subsystem_usage[subsystem].peak_frame_bytes = bytes;
+		}
+		frame_bytes += bytes;
+		subsystem_frame_bytes[subsystem] = 0;
+	}
+	if(frame_bytes) {
+		frame_count++;
+		if(frame_bytes > total_usage.peak_frame_bytes) {
+			total_usage.peak_frame_bytes = frame_bytes;
+		}
+	}
+}
+
+static uint8_t count_dirty_in_row(uint8_t y) {
+	uint8_t count = 0;
+	for(uint16_t bits = dirty_rows[y]; bits; bits &= bits - 1) {
+		count++;
+	}
+	return count;
+}
+
+static uint8_t count_dirty_in_column(uint8_t x) {
+	uint8_t count = 0;
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		if(dirty_rows[y] & (1U << x)) {
+			count++;
+		}
+	}
+	return count;
+}
+
+// Wait until the bulk queue has room for a command of the given length.
+// Used for commands which can't be left until the next flush.
+static void wait_for_bulk_queue_space(uint8_t length) {
+	while(spi_queue_space(SPI_QUEUE_BULK) < length) {
+		; // wait for the interrupt handler to send some data
+	}
+}
+
+// The send functions queue a command to update the matrix from the shadow
+// frame. They return 0 (and do nothing) if the queue is full.
+static uint8_t send_all(void) {
+	if(!spi_queue_begin(SPI_QUEUE_BULK, BYTES_UPDATE_ALL)) {
+		return 0;
+	}
+	LedmatrixSubsystem owner = current_subsystem;
+	for(int8_t y = MATRIX_NUM_ROWS - 1; y >= 0; y--) {
+		if(dirty_rows[y]) {
+			owner = owner_of(first_dirty_x(y), y);
+		}
+	}
+	spi_queue_byte(CMD_UPDATE_ALL);
+	for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
+		for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
+			spi_queue_byte(shadow_frame[x][y]);
+			matrix_frame[x][y] = shadow_frame[x][y];
+		}
+		dirty_rows[y] = 0;
+		bulk_pending_rows[y] = 0xFFFF;
+	}
+	spi_queue_end();
+	record_command(LEDMATRIX_COMMAND_UPDATE_ALL, owner);
+	return 1;
+}
+
+static uint8_t send_row(uint8_t y) {
+	if(!spi_queue_begin(SPI_QUEUE_BULK, BYTES_UPDATE_ROW)) {
+		return 0;
+	}
+	LedmatrixSubsystem owner = owner_of(first_dirty_x(y), y);
+	spi_queue_byte(CMD_UPDATE_ROW);
+	spi_queue_byte(y & 0x07);	// row number
+	for(uint8_t x = 0; x<MATRIX_NUM_COLUMNS; x++) {
+		spi_queue_byte(shadow_frame[x][y]);
+		matrix_frame[x][y] = shadow_frame[x][y];
+	}
+	spi_queue_end();
+	dirty_rows[y] = 0;
+	bulk_pending_rows[y] = 0xFFFF;
+	record_command(LEDMATRIX_COMMAND_UPDATE_ROW, owner);
+	return 1;
+}
+
+static uint8_t send_column(uint8_t x) {
+	if(!spi_queue_begin(SPI_QUEUE_BULK, BYTES_UPDATE_COL)) {
+		return 0;
+	}
+	LedmatrixSubsystem owner = current_subsystem;
+	for(int8_t y = MATRIX_NUM_ROWS - 1; y >= 0; y--) {
+		if(dirty_rows[y] & (1U << x)) {
+			owner = owner_of(x, y);
+		}
+	}
+	spi_queue_byte(CMD_UPDATE_COL);
+	spi_queue_byte(x & 0x0F); // column number
+	for(uint8_t y = 0; y<MATRIX_NUM_ROWS; y++) {
+		spi_queue_byte(shadow_frame[x][y]);
+		matrix_frame[x][y] = shadow_frame[x][y];
+		dirty_rows[y] &= ~(1U << x);
+		bulk_pending_rows[y] |= (1U << x);
+	}
+	spi_queue_end();
+	record_command(LEDMATRIX_COMMAND_UPDATE_COL, owner);
+	return 1;
+}
+
+static uint8_t send_pixel(uint8_t x, uint8_t y, uint8_t queue) {
+	if(!spi_queue_begin(queue, BYTES_UPDATE_PIXEL)) {
+		return 0;
+	}
+	spi_queue_byte(CMD_UPDATE_PIXEL);
+	spi_queue_byte( ((y & 0x07)<<4) | (x & 0x0F));
+	spi_queue_byte(shadow_frame[x][y]);
+	spi_queue_end();
+	matrix_frame[x][y] = shadow_frame[x][y];
+	dirty_rows[y] &= ~(1U << x);
+	if(queue == SPI_QUEUE_BULK) {
+		bulk_pending_rows[y] |= (1U << x);
+	}
+	record_command(LEDMATRIX_COMMAND_UPDATE_PIXEL, owner_of(x, y));
+	return 1;
+}
+
+// Shift the display in the given direction (see the LED matrix reference
+// for the direction bits). The command is queued behind anything already
+// sent, so we shift our copy of what the matrix shows to match. The shadow
+// frame is shifted too - so changes that haven't been sent yet move along
+// with everything else. The matrix shifts blank pixels in.
+static void send_shift(uint8_t direction) {
+	wait_for_bulk_queue_space(BYTES_SHIFT_DISPLAY);
+	(void)spi_queue_begin(SPI_QUEUE_BULK, BYTES_SHIFT_DISPLAY);
+	spi_queue_byte(CMD_SHIFT_DISPLAY);
+	spi_queue_byte(direction);
+	spi_queue_end();
+	frame_bytes_requested += BYTES_SHIFT_DISPLAY;
+	record_command(LEDMATRIX_COMMAND_SHIFT, current_subsystem);
+	
+	int8_t dx = 0;
+	int8_t dy = 0;
+	if(direction == 0x02) {
+		dx = -1;	// left
+	} else if(direction == 0x01) {
+		dx = 1;		// right
+	} else if(direction == 0x08) {
+		dy = 1;		// up
+	} else {
+		dy = -1;	// down
+	}
+	shift_frame(matrix_frame, dx, dy);
+	shift_frame(shadow_frame, dx, dy);
+	shift_owners(dx, dy);
+	
+	// Work out which pixels now differ. Urgent pixels can't overtake the
+	// shift so everything counts as waiting on the bulk queue.
+	find_dirty_pixels();
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		bulk_pending_rows[y] = 0xFFFF;
+	}
+}
+
+// Mark every pixel where the shadow frame and matrix frame differ as dirty
+static void find_dirty_pixels(void) {
+	for(uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		dirty_rows[y] = 0;
+		for(uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+			if(shadow_frame[x][y] != matrix_frame[x][y]) {
+				dirty_rows[y] |= (1U << x);
+			}
+		}
+	}
+}
+
+// Busy wait for (at least) the given number of microseconds
+static void wait_for_gap(uint8_t microseconds) {
+	for(uint8_t i = 0; i < microseconds; i++) {
+		_delay_us(1);
+	}
+}
+
+// Move the contents of the given frame by (dx,dy) pixels, filling the
+// space left behind with black.
+static void shift_frame(MatrixData frame, int8_t dx, int8_t dy) {
+	// Work through the display in the opposite order to the shift so
+	// that we never overwrite a pixel before it has been moved.
+	for(uint8_t j = 0; j < MATRIX_NUM_ROWS; j++) {
+		uint8_t y = (dy > 0) ? (MATRIX_NUM_ROWS - 1 - j) : j;
+		for(uint8_t i = 0; i < MATRIX_NUM_COLUMNS; i++) {
+			uint8_t x = (dx > 0) ? (MATRIX_NUM_COLUMNS - 1 - i) : i;
+			int8_t from_x = x - dx;
+			int8_t from_y = y - dy;
+			PixelColour pixel = COLOUR_BLACK;
+			if(from_x >= 0 && from_x < MATRIX_NUM_COLUMNS && 
+					from_y >= 0 && from_y < MATRIX_NUM_ROWS) {
+				pixel = frame[from_x][from_y];
+			}
+			frame[x][y] = pixel;
+		}
+	}
+}
+
+// Move the pixel owners along with a shift of the frames (as for
+// shift_frame()). Pixels shifted in belong to the current subsystem.
+static void shift_owners(int8_t dx, int8_t dy) {
+	for(uint8_t j = 0; j < MATRIX_NUM_ROWS; j++) {
+		uint8_t y = (dy > 0) ? (MATRIX_NUM_ROWS - 1 - j) : j;
+		for(uint8_t i = 0; i < MATRIX_NUM_COLUMNS; i++) {
+			uint8_t x = (dx > 0) ? (MATRIX_NUM_COLUMNS - 1 - i) : i;
+			int8_t from_x = x - dx;
+			int8_t from_y = y - dy;
+			uint8_t owner = current_subsystem;
+			if(from_x >= 0 && from_x < MATRIX_NUM_COLUMNS && 
+					from_y >= 0 && from_y < MATRIX_NUM_ROWS) {
+				owner = owner_of(from_x, from_y);
+			}
+			set_owner(x, y, owner);
+		}
+	}
+}
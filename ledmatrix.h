@@ -22,6 +22,36 @@ typedef PixelColour MatrixData[MATRIX_NUM_COLUMNS][MATRIX_NUM_ROWS];
 typedef PixelColour MatrixRow[MATRIX_NUM_COLUMNS];
 typedef PixelColour MatrixColumn[MATRIX_NUM_ROWS];
 
+// Parts of the program that draw on the matrix. SPI usage is recorded
+// for each of these (see ledmatrix_set_subsystem()).
+typedef enum {
+	LEDMATRIX_SUBSYSTEM_BACKGROUND,
+	LEDMATRIX_SUBSYSTEM_ALIENS,
+	LEDMATRIX_SUBSYSTEM_PROJECTILES,
+	LEDMATRIX_SUBSYSTEM_PLAYER,
+	LEDMATRIX_SUBSYSTEM_SCROLLER,
+	LEDMATRIX_NUM_SUBSYSTEMS
+} LedmatrixSubsystem;
+
+// Types of command sent to the matrix (SPI usage is also recorded for each)
+typedef enum {
+	LEDMATRIX_COMMAND_UPDATE_ALL,
+	LEDMATRIX_COMMAND_UPDATE_PIXEL,
+	LEDMATRIX_COMMAND_UPDATE_ROW,
+	LEDMATRIX_COMMAND_UPDATE_COL,
+	LEDMATRIX_COMMAND_SHIFT,
+	LEDMATRIX_COMMAND_CLEAR,
+	LEDMATRIX_NUM_COMMANDS
+} LedmatrixCommand;
+
+// SPI usage totals. A frame is a call to ledmatrix_flush() which sent
+// something - frames where nothing changed are not counted.
+typedef struct {
+	uint32_t bytes;
+	uint32_t commands;
+	uint16_t peak_frame_bytes;	// Most bytes sent in a single frame
+} LedmatrixUsage;
+
 // Setup SPI communication with the LED matrix.
 // This function must be called before the LED matrix functions
 // below are used.
@@ -31,8 +61,15 @@ void ledmatrix_setup(void);
 // For those functions which take an x or a y value, the value must be valid
 // or the request will be ignored. (i.e. x must be < MATRIX_NUM_COLUMNS
 // and y must be < MATRIX_NUM_ROWS)
+// The update functions only record the change in a copy of the display -
+// nothing is sent until ledmatrix_flush() is called. The shift and clear
+// functions take effect immediately - changes not sent yet are shifted
+// along with the display, or thrown away by a clear.
 void ledmatrix_update_all(MatrixData data);
 void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel);
+// As above, but the pixel will be sent ahead of any large updates still
+// waiting to be sent (for things like the player that must appear promptly)
+void ledmatrix_update_pixel_urgent(uint8_t x, uint8_t y, PixelColour pixel);
 void ledmatrix_update_row(uint8_t y, MatrixRow row);
 void ledmatrix_update_column(uint8_t x, MatrixColumn col);
 void ledmatrix_shift_display_left(void);
@@ -41,6 +78,61 @@ void ledmatrix_shift_display_up(void);
 void ledmatrix_shift_display_down(void);
 void ledmatrix_clear(void);
 
+// Send all pending changes to the matrix, using whichever mix of pixel, row,
+// column and whole display commands needs the fewest bytes. Pixels whose
+// colour ends up unchanged are not sent. Should be called once per tick
+// (i.e. after each batch of drawing).
+void ledmatrix_flush(void);
+
+// Return 1 if any pixels are still to be sent to the matrix (i.e. the last
+// ledmatrix_flush() stopped because the SPI queue was full), 0 otherwise
+uint8_t ledmatrix_has_unsent(void);
+
+// Return 1 if everything drawn has reached the matrix - nothing is left
+// to flush and nothing is waiting in (or being sent from) either SPI
+// queue - 0 otherwise. (A changed pixel may go in either queue.)
+uint8_t ledmatrix_all_sent(void);
+
+// Count pixel updates that were asked for but merged together before
+// they got here (e.g. by the compositor), so the saving below is measured
+// against every update the game asked for.
+void ledmatrix_count_merged_pixels(uint16_t pixels);
+
+// Get the number of SPI bytes saved compared to sending every update
+// request as it was made, and the number of frames this covers, since
+// usage was last reset. A frame ends when ledmatrix_flush() has sent all
+// of it - a flush that stops early carries its requests on to the next.
+void ledmatrix_get_bytes_saved(uint32_t* bytes, uint32_t* frames);
+
+// Change the speed of the SPI link to the matrix - see spi_setup_master()
+// and spi_set_command_gap(). Waits for anything already queued to be sent.
+void ledmatrix_set_link_speed(uint8_t clockdivider, uint8_t command_gap);
+
+// Show the link test image at the current link speed. The display is
+// filled with orange, then each row is set to yellow, then the test image
+// (a border of the given colour around the fill colour) is drawn one
+// pixel at a time - all sent straight away with (at least) the given gap
+// in microseconds between commands. If the matrix can't keep up, some of the image will be wrong.
+// (The matrix sends nothing back that would show this, so someone has to
+// look.) The next ledmatrix_flush() puts back what should be shown.
+void ledmatrix_show_link_test(uint8_t command_gap, PixelColour border, 
+		PixelColour fill);
+
+// Set the subsystem that following drawing is done for. Each pixel
+// remembers the subsystem that drew it (erasing a pixel to black leaves
+// it belonging to whoever drew it). Commands are charged to the subsystem
+// of the first changed pixel they send. Shift and clear commands are
+// charged to the current subsystem.
+void ledmatrix_set_subsystem(LedmatrixSubsystem subsystem);
+
+// Get SPI usage for a subsystem, for a command type, or overall - and
+// the number of frames these were sent in. Usage can be reset to zero.
+void ledmatrix_get_subsystem_usage(LedmatrixSubsystem subsystem, LedmatrixUsage* usage);
+void ledmatrix_get_command_usage(LedmatrixCommand command, LedmatrixUsage* usage);
+void ledmatrix_get_total_usage(LedmatrixUsage* usage);
+uint32_t ledmatrix_get_frame_count(void);
+void ledmatrix_reset_usage(void);
+
 // Functions to operate on MatrixRow and MatrixColumn data structures
 void copy_matrix_column(MatrixColumn from, MatrixColumn to);
 void copy_matrix_row(MatrixRow from, MatrixRow to);
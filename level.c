@@ -32,6 +32,8 @@
 
 volatile uint8_t level = 1;
 uint16_t count = 1;
+// Whether the level up message is showing (1) or not (0)
+uint8_t level_up_showing = 0;
 
 
 
@@ -61,20 +63,34 @@ void check_if_level_up(void) {
 	}
 }
 
+// Start showing the level up message. It is scrolled by
+// level_up_screen_service() until a button is pushed or a key is pressed.
 void level_up_spash_screen(void) {
+	ledmatrix_set_subsystem(LEDMATRIX_SUBSYSTEM_SCROLLER);
 	ledmatrix_clear();
-	while(1) {
-		set_scrolling_display_text("LEVEL UP", COLOUR_GREEN);
-		// Scroll the message until it has scrolled off the
-		// display or a button is pushed. We pause for 130ms between each scroll.
-		while(scroll_display()) {
-			_delay_ms(130);
-			if(button_pushed() != NO_BUTTON_PUSHED || serial_input_available()) {
-				clear_serial_input_buffer();
-				init_background();
-				init_player();
-				return;
-			}
-		}
+	start_scrolling_display(MARQUEE_LEVEL_UP, COLOUR_GREEN, SCROLLING_DISPLAY_MS_PER_COLUMN);
+	level_up_showing = 1;
+}
+
+uint8_t level_up_screen_showing(void) {
+	return level_up_showing;
+}
+
+void level_up_screen_service(void) {
+	if(!level_up_showing) {
+		return;
+	}
+	// Scroll the message in the background (again and again) until
+	// a button is pushed or a key is pressed
+	scrolling_display_service();
+	if(scrolling_display_finished()) {
+		start_scrolling_display(MARQUEE_LEVEL_UP, COLOUR_GREEN, SCROLLING_DISPLAY_MS_PER_COLUMN);
+	}
+	if(button_pushed() != NO_BUTTON_PUSHED || serial_input_available()) {
+		cancel_scrolling_display();
+		clear_serial_input_buffer();
+		init_background();
+		init_player();
+		level_up_showing = 0;
 	}
 }
\ No newline at end of file
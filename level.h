@@ -11,4 +11,9 @@ uint8_t get_level(void);
 void init_level(void);
 void increase_level();
 void check_if_level_up(void);
-void level_up_spash_screen(void);
\ No newline at end of file
+void level_up_spash_screen(void);
+// Return 1 while the level up message is showing, 0 otherwise
+uint8_t level_up_screen_showing(void);
+// Scroll the level up message and finish with it once a button is pushed
+// or a key is pressed. Should be called frequently while it is showing.
+void level_up_screen_service(void);
\ No newline at end of file
@@ -0,0 +1,31 @@
+/*
+ * level_design.h
+ *
+ * How levels are stored in program memory. The designs themselves are
+ * written as text files in levels/ and compiled into level_pack.c by
+ * tools/levelc.c.
+ */ 
+
+#ifndef LEVEL_DESIGN_H_
+#define LEVEL_DESIGN_H_
+
+#include <stdint.h>
+#include "pixel_colour.h"
+#include "background_generator.h"
+
+// A level's background is either designed (terrain points to run length
+// coded columns) or generated (terrain is 0 and seed and style are given
+// to the background generator). Run length coded columns are pairs of
+// bytes - a count (1 to 255) and the column (bit 0 is row 0) to repeat
+// that many times. A count of 0 marks the end, after which the terrain
+// starts again from the beginning.
+typedef struct {
+	const uint8_t* terrain;
+	uint16_t seed;
+	uint8_t style;
+	PixelColour colour;
+	uint16_t alien_move_ms;		// time between alien moves (at normal speed)
+	uint16_t alien_add_ms;		// time between attempts to add an alien
+} LevelDesign;
+
+#endif /* LEVEL_DESIGN_H_ */
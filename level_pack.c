@@ -0,0 +1,31 @@
+/*
+ * level_pack.c
+ *
+ * GENERATED by tools/levelc.c from the level designs in levels/
+ * - do not edit. See level_design.h for the format.
+ */
+
+#include <avr/pgmspace.h>
+#include "level_pack.h"
+
+// levels/01_valley.txt
+static const uint8_t terrain_0[] PROGMEM = {
+		1, 0x03, 3, 0x07, 1, 0x03, 3, 0x01, 4, 0x00, 2, 0x01,
+		2, 0x03, 2, 0x01, 1, 0x10, 2, 0x18, 2, 0x3C, 1, 0x38,
+		1, 0x18, 1, 0x10, 3, 0x01, 1, 0x03, 2, 0x07,
+		0 };
+
+// levels/02_stalactites.txt
+static const uint8_t terrain_1[] PROGMEM = {
+		1, 0x03, 2, 0x07, 2, 0x03, 1, 0x01, 1, 0x8F, 1, 0x81,
+		1, 0xC0, 1, 0xE0, 2, 0x00, 2, 0x01, 2, 0x03, 2, 0x01,
+		1, 0x10, 2, 0x18, 2, 0x3C, 1, 0x38, 1, 0x18, 1, 0x10,
+		3, 0x01, 1, 0x03, 2, 0x07,
+		0 };
+
+const LevelDesign level_designs[NUM_LEVEL_DESIGNS] PROGMEM = {
+	{ terrain_0, 0x0000, 0, COLOUR_GREEN, 400, 1000 },	// levels/01_valley.txt
+	{ terrain_1, 0x0000, 0, COLOUR_LIGHT_YELLOW, 400, 1000 },	// levels/02_stalactites.txt
+	{ 0, 0x3A51, 0 | BACKGROUND_STYLE_FLOOR | BACKGROUND_STYLE_OBSTACLES, COLOUR_GREEN, 350, 900 },	// levels/03_plains.txt
+	{ 0, 0xC0DE, 0 | BACKGROUND_STYLE_FLOOR | BACKGROUND_STYLE_CEILING | BACKGROUND_STYLE_OBSTACLES, COLOUR_LIGHT_YELLOW, 300, 800 }	// levels/04_caverns.txt
+};
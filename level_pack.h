@@ -0,0 +1,18 @@
+/*
+ * level_pack.h
+ *
+ * GENERATED by tools/levelc.c from the level designs in levels/
+ * - do not edit. See level_design.h for the format.
+ */
+
+#ifndef LEVEL_PACK_H_
+#define LEVEL_PACK_H_
+
+#include "level_design.h"
+
+#define NUM_LEVEL_DESIGNS 4
+
+// Level designs (in program memory) in the order they are played
+extern const LevelDesign level_designs[NUM_LEVEL_DESIGNS];
+
+#endif /* LEVEL_PACK_H_ */
@@ -0,0 +1,113 @@
+/*
+ * link_tuning.c
+ *
+ * See link_tuning.h for an overview.
+ */ 
+
+#include <avr/eeprom.h>
+#include <stdint.h>
+#include "link_tuning.h"
+#include "ledmatrix.h"
+
+// Clock dividers (slowest first) and gaps between commands to try at each
+// (in microseconds, smallest first). The first divider is always safe and
+// isn't tried. There are only a few gaps as each one tried means asking
+// about another test image.
+static const uint8_t dividers[] = { 128, 64, 32, 16, 8, 4, 2 };
+static const uint8_t gaps[] = { 0, 50, 200 };
+#define NUM_DIVIDERS	(sizeof(dividers) / sizeof(dividers[0]))
+#define NUM_GAPS		(sizeof(gaps) / sizeof(gaps[0]))
+
+// Link settings as saved in EEPROM. check is the bitwise inverse of
+// the divider XORed with the gap, so that blank (or old) EEPROM contents
+// are not mistaken for settings.
+#define SETTINGS_MAGIC 0x5A
+typedef struct {
+	uint8_t magic;
+	uint8_t divider;
+	uint8_t gap;
+	uint8_t check;
+} LinkSettings;
+
+static LinkSettings EEMEM saved_settings;
+
+// The settings in use
+static uint8_t current_divider = 128;
+static uint8_t current_gap = 0;
+
+static uint8_t is_valid_divider(uint8_t divider);
+static void use_link_speed(uint8_t divider, uint8_t gap);
+
+///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
+
+void link_tuning_apply_saved(void) {
+	LinkSettings settings;
+	eeprom_read_block(&settings, &saved_settings, sizeof(settings));
+	if(settings.magic == SETTINGS_MAGIC && 
+			settings.check == (uint8_t)~(settings.divider ^ settings.gap) &&
+			is_valid_divider(settings.divider)) {
+		use_link_speed(settings.divider, settings.gap);
+	}
+}
+
+void link_tuning_calibrate(LinkTestCheck check_test_image) {
+	uint8_t best_divider = dividers[0];
+	uint8_t best_gap = 0;
+	PixelColour border = COLOUR_RED;
+	PixelColour fill = COLOUR_GREEN;
+	
+	// Work up from the slowest speed, stopping at the first divider where
+	// no gap works
+	for(uint8_t i = 1; i < NUM_DIVIDERS; i++) {
+		uint8_t found = 0;
+		for(uint8_t j = 0; !found && j < NUM_GAPS; j++) {
+			// Swap the colours so each image differs from the last
+			PixelColour swap = border;
+			border = fill;
+			fill = swap;
+			use_link_speed(dividers[i], gaps[j]);
+			ledmatrix_show_link_test(gaps[j], border, fill);
+			if(check_test_image(border, fill)) {
+				best_divider = dividers[i];
+				best_gap = gaps[j];
+				found = 1;
+			}
+		}
+		if(!found) {
+			break;
+		}
+	}
+	use_link_speed(best_divider, best_gap);
+	
+	LinkSettings settings;
+	settings.magic = SETTINGS_MAGIC;
+	settings.divider = best_divider;
+	settings.gap = best_gap;
+	settings.check = ~(best_divider ^ best_gap);
+	eeprom_update_block(&settings, &saved_settings, sizeof(settings));
+}
+
+uint8_t link_tuning_get_divider(void) {
+	return current_divider;
+}
+
+uint8_t link_tuning_get_gap(void) {
+	return current_gap;
+}
+
+/////////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+static uint8_t is_valid_divider(uint8_t divider) {
+	for(uint8_t i = 0; i < NUM_DIVIDERS; i++) {
+		if(dividers[i] == divider) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void use_link_speed(uint8_t divider, uint8_t gap) {
+	ledmatrix_set_link_speed(divider, gap);
+	current_divider = divider;
+	current_gap = gap;
+}
@@ -0,0 +1,41 @@
+/*
+ * link_tuning.h
+ *
+ * The LED matrix only has a small input buffer, so by default the SPI
+ * link runs at the slowest speed (clock divided by 128), which it can
+ * always keep up with. Calibration tries faster clock dividers, each with
+ * increasing gaps between commands, showing a test image at each and
+ * asking whether it looks right. (Each byte sent comes back from the
+ * matrix's shift register whether or not the matrix kept up, so only
+ * looking at the display tells us.) The fastest combination confirmed is
+ * saved in EEPROM and used from then on.
+ */ 
+
+#ifndef LINK_TUNING_H_
+#define LINK_TUNING_H_
+
+#include <stdint.h>
+#include "pixel_colour.h"
+
+// Use the link speed saved by the last calibration (if there is one).
+// ledmatrix_setup() must have been called first.
+void link_tuning_apply_saved(void);
+
+// Called by calibration once the test image - a border of one colour
+// around the other (see ledmatrix_show_link_test()) - has been shown at
+// the speed given by link_tuning_get_divider() and link_tuning_get_gap().
+// Should return 1 if the image looks right and 0 if not. The colours swap
+// on each try, so an image left over from the last try looks wrong.
+typedef uint8_t (*LinkTestCheck)(PixelColour border, PixelColour fill);
+
+// Find the fastest link speed at which check_test_image confirms the test
+// image, use it and save it. If none is confirmed the slowest speed is
+// used (and saved).
+void link_tuning_calibrate(LinkTestCheck check_test_image);
+
+// Return the clock divider and the gap between commands (in microseconds)
+// currently in use
+uint8_t link_tuning_get_divider(void);
+uint8_t link_tuning_get_gap(void);
+
+#endif /* LINK_TUNING_H_ */
@@ -0,0 +1,36 @@
+/*
+ * marquee_data.c
+ *
+ * GENERATED by tools/marquee_gen.c from tools/marquee_messages.txt
+ * - do not edit. Column data for the scrolling messages (see
+ * scrolling_char_display.h).
+ */
+
+#include <avr/pgmspace.h>
+#include "marquee_data.h"
+
+// SPACE IMPACT  SEBASTIAN NARLOCH 44345714
+const uint8_t MARQUEE_SPLASH[182] PROGMEM = {
+		0, 0, 100, 146, 146, 76, 0, 254, 144, 144, 96, 0,
+		126, 144, 144, 126, 0, 124, 130, 130, 68, 0, 254, 146,
+		146, 130, 0, 0, 130, 254, 130, 0, 254, 64, 48, 64,
+		254, 0, 254, 144, 144, 96, 0, 126, 144, 144, 126, 0,
+		124, 130, 130, 68, 0, 128, 128, 254, 128, 128, 0, 0,
+		0, 100, 146, 146, 76, 0, 254, 146, 146, 130, 0, 254,
+		146, 146, 108, 0, 126, 144, 144, 126, 0, 100, 146, 146,
+		76, 0, 128, 128, 254, 128, 128, 0, 130, 254, 130, 0,
+		126, 144, 144, 126, 0, 254, 32, 16, 254, 0, 0, 254,
+		32, 16, 254, 0, 126, 144, 144, 126, 0, 254, 144, 152,
+		102, 0, 254, 2, 2, 2, 0, 124, 130, 130, 124, 0,
+		124, 130, 130, 68, 0, 254, 16, 16, 254, 0, 0, 24,
+		40, 72, 254, 0, 24, 40, 72, 254, 0, 68, 146, 146,
+		108, 0, 24, 40, 72, 254, 0, 228, 162, 162, 156, 0,
+		128, 158, 160, 192, 0, 66, 254, 2, 0, 24, 40, 72,
+		254, 1 };
+
+// LEVEL UP
+const uint8_t MARQUEE_LEVEL_UP[39] PROGMEM = {
+		0, 0, 254, 2, 2, 2, 0, 254, 146, 146, 130, 0,
+		248, 4, 2, 4, 248, 0, 254, 146, 146, 130, 0, 254,
+		2, 2, 2, 0, 0, 252, 2, 2, 252, 0, 254, 144,
+		144, 96, 1 };
@@ -0,0 +1,17 @@
+/*
+ * marquee_data.h
+ *
+ * GENERATED by tools/marquee_gen.c from tools/marquee_messages.txt
+ * - do not edit. Column data for the scrolling messages (see
+ * scrolling_char_display.h).
+ */
+
+#ifndef MARQUEE_DATA_H_
+#define MARQUEE_DATA_H_
+
+#include <stdint.h>
+
+extern const uint8_t MARQUEE_SPLASH[182];
+extern const uint8_t MARQUEE_LEVEL_UP[39];
+
+#endif /* MARQUEE_DATA_H_ */
@@ -0,0 +1,52 @@
+/*
+ * occupancy.c
+ *
+ * See occupancy.h for a description of the occupancy map.
+ */ 
+
+#include "occupancy.h"
+#include "game_position.h"
+#include <stdint.h>
+
+// One byte per position, column by column - position (x,y) is entry
+// x*8 + y. Positions with bit 3 set (y > 7) are invalid.
+#define MAP_INDEX(position)	((GET_X_POSITION(position) << 3) | GET_Y_POSITION(position))
+#define IS_VALID(position)	(((position) & 0x08) == 0)
+static uint8_t occupancy_map[16 * 8];
+
+// Summary of the map - bit y of occupied_rows[x] is set if (x,y) is occupied
+static uint8_t occupied_rows[16];
+
+void occupancy_remove_all(uint8_t kind) {
+	for(uint8_t i = 0; i < sizeof(occupancy_map); i++) {
+		if(OCCUPANT_KIND(occupancy_map[i]) == kind) {
+			occupancy_map[i] = OCCUPANT(OCCUPANT_NONE, 0);
+			occupied_rows[i >> 3] &= ~(1 << (i & 7));
+		}
+	}
+}
+
+uint8_t occupant_at(uint8_t position) {
+	if(!IS_VALID(position)) {
+		return OCCUPANT(OCCUPANT_NONE, 0);
+	}
+	return occupancy_map[MAP_INDEX(position)];
+}
+
+uint8_t occupied_rows_in_column(uint8_t x) {
+	return occupied_rows[x];
+}
+
+void occupancy_set(uint8_t position, uint8_t occupant) {
+	if(IS_VALID(position)) {
+		occupancy_map[MAP_INDEX(position)] = occupant;
+		occupied_rows[GET_X_POSITION(position)] |= (1 << GET_Y_POSITION(position));
+	}
+}
+
+void occupancy_clear(uint8_t position, uint8_t occupant) {
+	if(IS_VALID(position) && occupancy_map[MAP_INDEX(position)] == occupant) {
+		occupancy_map[MAP_INDEX(position)] = OCCUPANT(OCCUPANT_NONE, 0);
+		occupied_rows[GET_X_POSITION(position)] &= ~(1 << GET_Y_POSITION(position));
+	}
+}
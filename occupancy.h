@@ -0,0 +1,44 @@
+/*
+ * occupancy.h
+ *
+ * A map of the game field recording which alien (if any) occupies each
+ * position, so that finding the alien at a position is a single array
+ * read. The alien module keeps the map up to date as aliens are added,
+ * moved and removed. An alien occupies all four of its positions.
+ * (Projectiles don't need numbers, so they are just kept as a mask per
+ * row - see projectile.c.)
+ */ 
+
+#ifndef OCCUPANCY_H_
+#define OCCUPANCY_H_
+
+#include <stdint.h>
+
+// An occupant is recorded as a kind (top 2 bits) and a number (bottom
+// 6 bits) - e.g. the alien number
+#define OCCUPANT_NONE			0
+#define OCCUPANT_ALIEN			1
+#define OCCUPANT(kind, number)	(((kind) << 6) | (number))
+#define OCCUPANT_KIND(occupant)		((occupant) >> 6)
+#define OCCUPANT_NUMBER(occupant)	((occupant) & 0x3F)
+
+// Remove all occupants of the given kind from the map
+void occupancy_remove_all(uint8_t kind);
+
+// Return the occupant at the given position (see game_position.h). The
+// kind will be OCCUPANT_NONE if there is nothing there or the position is
+// invalid.
+uint8_t occupant_at(uint8_t position);
+
+// Return the rows of the given column (0 to 15) that have something in
+// them - bit y is set if position (x,y) is occupied
+uint8_t occupied_rows_in_column(uint8_t x);
+
+// Record the given occupant at the given position
+void occupancy_set(uint8_t position, uint8_t occupant);
+
+// Remove the given occupant from the given position. Nothing is done if
+// something else is recorded there.
+void occupancy_clear(uint8_t position, uint8_t occupant);
+
+#endif /* OCCUPANCY_H_ */
@@ -4,7 +4,7 @@
  * Author: Peter Sutton
  */ 
 
-#include "ledmatrix.h"
+#include "compositor.h"
 #include "pixel_colour.h"
 #include "game_position.h"
 #include "projectile.h"
@@ -47,6 +47,7 @@ void init_player(void) {
 	
 	// Player is not initially dead :-)
 	player_dead = 0;
+	compositor_clear_layer(LAYER_PLAYER);
 	
 	// Display the initial player. It is assumed that the
 	// initial player position does not overlap the background.
@@ -126,13 +127,16 @@ uint8_t get_player_position(void) {
 }
 
 void check_if_player_is_dead(void) {
-	// The position of the second player pixel is immediately to the right -
-	// work out this position
-	uint8_t second_pixel_position = position_to_right_of(player_position);
-		
-	if(is_background_at(player_position) || is_background_at(second_pixel_position) ||
-			is_alien_at(player_position) || is_alien_at(second_pixel_position)) {
-		// Have just worked out that the player is dead - redraw them
+	// The player is dead if either of its pixels (the position and the
+	// one to the right) is on background, an alien or a projectile fired
+	// by an alien
+	uint8_t playerY = GET_Y_POSITION(player_position);
+	uint16_t deadly = compositor_get_row(LAYER_BACKGROUND, playerY) | 
+			compositor_get_row(LAYER_ALIENS, playerY) |
+			compositor_get_row(LAYER_ALIEN_PROJECTILES, playerY);
+	if(deadly & (3U << GET_X_POSITION(player_position))) {
+		// Have just worked out that the player is dead - redraw them in
+		// the dead player colour
 		player_dead = 1;
 		redraw_player();
 	}
@@ -146,16 +150,17 @@ uint8_t is_player_dead(void) {
 
 //////////////////////// REDRAWING FUNCTIONS /////////////////////////////////
 
-// Erase the player (we assume it hasn't crashed - so we just replace
-// the player position with black)
+// Erase the player from the player layer
 static void erase_player(void) {
 	uint8_t playerX = GET_X_POSITION(player_position);
 	uint8_t playerY = GET_Y_POSITION(player_position);
-	ledmatrix_update_pixel(playerX, playerY, COLOUR_BLACK);
-	ledmatrix_update_pixel(playerX + 1, playerY, COLOUR_BLACK);
+	compositor_clear_pixel(LAYER_PLAYER, playerX, playerY);
+	compositor_clear_pixel(LAYER_PLAYER, playerX + 1, playerY);
 }
 
-// Redraw the player in its current position.
+// Redraw the player in its current position. (The player layer is above
+// the background and aliens, so a dead player is shown over whatever it
+// crashed into.)
 static void redraw_player(void) {
 	uint8_t player_colour = COLOUR_PLAYER;
 	if(player_dead) {
@@ -163,6 +168,7 @@ static void redraw_player(void) {
 	}
 	uint8_t playerX = GET_X_POSITION(player_position);
 	uint8_t playerY = GET_Y_POSITION(player_position);
-	ledmatrix_update_pixel(playerX, playerY, player_colour);
-	ledmatrix_update_pixel(playerX + 1, playerY, player_colour);
+	compositor_set_layer_colour(LAYER_PLAYER, player_colour);
+	compositor_set_pixel(LAYER_PLAYER, playerX, playerY);
+	compositor_set_pixel(LAYER_PLAYER, playerX + 1, playerY);
 }
@@ -13,60 +13,124 @@
 #include <string.h>
 
 #include "ledmatrix.h"
+#include "compositor.h"
+#include "game_position.h"
+#include "spi.h"
+#include "link_tuning.h"
 #include "scrolling_char_display.h"
 #include "buttons.h"
 #include "serialio.h"
 #include "terminalio.h"
 #include "score.h"
 #include "timer0.h"
+#include "timer1.h"
 #include "player.h"
 #include "alien.h"
 #include "game_background.h"
+#include "flow_field.h"
 #include "projectile.h"
 #include "level.h"
-
-#define F_CPU 8000000L
-#include <util/delay.h>
+#include "input.h"
+#include "scheduler.h"
+#include "idle.h"
+#include "joystick.h"
 
 // Function prototypes - these are defined below (after main()) in the order
 // given here
 void initialise_hardware(void);
 void splash_screen(void);
+void splash_screen_service(void);
 void new_game(void);
 void play_game(void);
+uint8_t still_playing(void);
+void level_up(void);
+void handle_death(void);
 void handle_game_over(void);
 void seven_seg_ports(void);
 void init_health_bar(void);
 uint8_t get_lives(void);
 void show_lives(void);
+void show_spi_usage(void);
+void calibrate_led_matrix_link(void);
+uint8_t link_test_image_correct(PixelColour border, PixelColour fill);
+void show_joystick_calibration(void);
+void set_game_speeds(void);
+void start_game_tasks(void);
+void set_level_task_periods(void);
+void scroll_game_background(void);
+void try_to_add_alien(void);
+void wait_for_work(void);
+uint32_t time_until_next_work(void);
+uint8_t handle_input_event(uint8_t action);
+void show_input_latency(void);
 
-// ASCII code for Escape character
-#define ESCAPE_CHAR 27
+// What the game is doing. Each time through the main loop we do a little
+// of whatever the current state needs - nothing waits.
+typedef enum {
+	STATE_SPLASH,		// splash screen message scrolling
+	STATE_STARTING,		// new game shown, waiting for play to start
+	STATE_PLAYING,
+	STATE_LEVEL_UP,		// level up message scrolling
+	STATE_DYING,		// player has died, waiting for the next life
+	STATE_GAME_OVER		// waiting for a button push to start again
+} GameState;
+GameState game_state = STATE_SPLASH;
+// When the current state ends (for states that last a fixed time)
+uint32_t state_end_time = 0;
 
 //Pause state for game (0 = not paused, 1 = paused)
 uint8_t paused = 0;
 // Four lives
 uint8_t lives = 4;
-//joystick axis
-uint8_t x_y_axis = 0;
-//joystick value
-uint16_t value = 0;
+// Scheduler tasks whose pace is set by the level, and the level it was set for
+uint8_t alien_add_task;
+uint8_t alien_move_task;
+uint8_t scroll_task;
+uint8_t tasks_level;
+// Steps the aliens, projectiles and background take each time they move
+// (see set_game_speeds())
+uint8_t steps_per_move = 1;
 
 /////////////////////////////// main //////////////////////////////////
 int main(void) {
 	// Setup hardware. This will turn on interrupts.
 	initialise_hardware();
 	
-	// Show the splash screen message. Returns when display
-	// is complete
+	// Show the splash screen message. The first game starts when a button
+	// is pushed or a key is pressed.
 	splash_screen();
 	
 	while(1) {
-		new_game();
-		play_game();
-		handle_game_over();
-		update_serial();
-		show_lives();
+		switch(game_state) {
+			case STATE_SPLASH:
+				splash_screen_service();
+				break;
+			case STATE_STARTING:
+				if(get_current_time() >= state_end_time) {
+					start_game_tasks();
+					game_state = STATE_PLAYING;
+				}
+				break;
+			case STATE_PLAYING:
+				play_game();
+				break;
+			case STATE_LEVEL_UP:
+				level_up();
+				break;
+			case STATE_DYING:
+				if(get_current_time() >= state_end_time) {
+					// On to the next life
+					lives -= 1;
+					update_serial();
+					show_lives();
+					new_game();
+				}
+				break;
+			case STATE_GAME_OVER:
+				handle_game_over();
+				break;
+		}
+		wait_for_work();
 	}
 }
 
@@ -120,6 +184,7 @@ void death_sound(void) {
 
 void initialise_hardware(void) {
 	ledmatrix_setup();
+	link_tuning_apply_saved();
 	init_button_interrupts();
 	
 	// Setup serial port for 38400 baud communication with no echo
@@ -127,6 +192,7 @@ void initialise_hardware(void) {
 	init_serial_stdio(38400,0);
 	
 	init_timer0();
+	init_timer1();
 	
 	init_health_bar();
 	
@@ -135,12 +201,8 @@ void initialise_hardware(void) {
 	
 	seven_seg_ports(); // initialise seven seg dispay
 	
-	
-	// set up ADC
-	ADMUX = (1<<REFS0);
-	ADCSRA = (1<<ADEN) | (1<<ADPS2) | (1<<ADPS1);
-	
-	
+	// Start reading the joystick
+	init_joystick();
 }
 
 void seven_seg_ports(void) {
@@ -154,19 +216,28 @@ void init_health_bar(void) {
 	PORTD |= (1<<2) | (1<<3) | (1<<4) | (1<<5); // turn on LED's
 }
 
-// method for handling LED health bar and death sound
+// method for handling LED health bar and death sound. The next life starts
+// 2 seconds after death (see main()) - or it's game over if this was the
+// last one.
 void handle_death(void) {
+	set_game_clock_running(0);
+	state_end_time = get_current_time() + 2000;
+	game_state = STATE_DYING;
 	if (lives == 4) {
 		PORTD ^= (1<<2); // turn off the LED
-		_delay_ms(2000); // delay for 2 seconds after death
 	} else if (lives == 3) {
 		PORTD ^= (1<<5);
-		_delay_ms(2000);
 	} else if (lives == 2) {
 		PORTD ^= (1<<3);
-		_delay_ms(2000);
 	} else if (lives == 1) {
 		PORTD ^= (1 << 4);
+		reset_level_counter();
+		move_cursor(10,14);
+		// Print a message to the terminal.
+		printf_P(PSTR("GAME OVER"));
+		move_cursor(10,15);
+		printf_P(PSTR("Press a button to start again"));
+		game_state = STATE_GAME_OVER;
 	}
 }
 
@@ -182,41 +253,276 @@ void show_lives(void) {
 	printf_P(PSTR("% 10d"), get_lives());
 }
 
-// method for joystick functionality
-void joystick_functionality(void) {
-	// joystick functionality
-	if (x_y_axis == 0) {
-		ADMUX &= ~1;
-		} else {
-		ADMUX |= 1;
+// Print how the LED matrix SPI link is being used - overall, by each
+// part of the game and by each type of command - and what was saved
+void show_spi_usage(void) {
+	static const char subsystem_names[LEDMATRIX_NUM_SUBSYSTEMS][12] PROGMEM = {
+		"Background", "Aliens", "Projectiles", "Player", "Scroller"
+	};
+	static const char command_names[LEDMATRIX_NUM_COMMANDS][12] PROGMEM = {
+		"Update all", "Pixel", "Row", "Column", "Shift", "Clear"
+	};
+	LedmatrixUsage usage;
+	uint32_t frames = ledmatrix_get_frame_count();
+	
+	ledmatrix_get_total_usage(&usage);
+	move_cursor(10,20);
+	printf_P(PSTR("SPI: %lu frames, avg %lu peak %u bytes/frame, queue full %u   "), 
+			frames, frames ? usage.bytes / frames : 0, usage.peak_frame_bytes, 
+			spi_queue_full_count());
+	for(uint8_t i = 0; i < LEDMATRIX_NUM_SUBSYSTEMS; i++) {
+		ledmatrix_get_subsystem_usage(i, &usage);
+		move_cursor(10,21+i);
+		printf_P(PSTR("%-11S %8lu bytes %6lu cmds peak %3u   "), subsystem_names[i], 
+				usage.bytes, usage.commands, usage.peak_frame_bytes);
 	}
-	
-	// ADC conversion
-	ADCSRA |= (1 << ADSC);
-	
-	while (ADCSRA & (1<<ADSC)) {
-		;
+	for(uint8_t i = 0; i < LEDMATRIX_NUM_COMMANDS; i++) {
+		ledmatrix_get_command_usage(i, &usage);
+		move_cursor(10,21+LEDMATRIX_NUM_SUBSYSTEMS+i);
+		printf_P(PSTR("%-11S %8lu bytes %6lu cmds   "), command_names[i], 
+				usage.bytes, usage.commands);
 	}
-	
-	value = ADC; // read the value
-	
-	if (x_y_axis == 0) { // x axis	
-		if (value > 700) {
-			move_player_left();
-		} else if (value < 300) {
-			move_player_right();
+	// What merging and combining updates saved, compared to sending each
+	// update the game asked for as it was made
+	uint32_t bytes_saved;
+	ledmatrix_get_bytes_saved(&bytes_saved, &frames);
+	move_cursor(10,21+LEDMATRIX_NUM_SUBSYSTEMS+LEDMATRIX_NUM_COMMANDS);
+	printf_P(PSTR("Saved %lu bytes over %lu frames, avg %lu bytes/frame   "), 
+			bytes_saved, frames, frames ? bytes_saved / frames : 0);
+}
+
+// Find the fastest speed the LED matrix link works at and report it
+void calibrate_led_matrix_link(void) {
+	link_tuning_calibrate(link_test_image_correct);
+	move_cursor(3,7);
+	printf_P(PSTR("LED matrix link calibrated: divider %d, gap %dus"), 
+			link_tuning_get_divider(), link_tuning_get_gap());
+	clear_to_end_of_line();
+}
+
+// Ask whether the LED matrix shows the link test image correctly (y or n)
+uint8_t link_test_image_correct(PixelColour border, PixelColour fill) {
+	move_cursor(3,7);
+	printf_P(PSTR("Divider %3d, gap %3dus: is the matrix a %S border around %S? (y/n)"), 
+			link_tuning_get_divider(), link_tuning_get_gap(),
+			border == COLOUR_GREEN ? PSTR("green") : PSTR("red"),
+			fill == COLOUR_GREEN ? PSTR("green") : PSTR("red"));
+	while(1) {
+		char c = fgetc(stdin);
+		if(c == 'y' || c == 'Y') {
+			return 1;
+		} else if(c == 'n' || c == 'N') {
+			return 0;
 		}
-	} else if (x_y_axis == 1) { // y axis
-			if (value > 700 ) {
-				move_player_up();
-			} else if (value < 300) {
+	}
+}
+
+// Report the joystick's centre and deadzone
+void show_joystick_calibration(void) {
+	move_cursor(3,8);
+	printf_P(PSTR("Joystick calibrated: centre %u,%u deadzone %u,%u   "), 
+			joystick_get_centre(JOYSTICK_X), joystick_get_centre(JOYSTICK_Y),
+			joystick_get_deadzone(JOYSTICK_X), joystick_get_deadzone(JOYSTICK_Y));
+}
+
+// Set how far the aliens, projectiles and background move each time they
+// are moved. In double speed mode they take two steps at a time rather
+// than being moved twice as often - their tasks keep the same periods, and
+// aliens are still added at the level's usual rate.
+void set_game_speeds(void) {
+	steps_per_move = (get_double_speed() % 2 == 0) ? 2 : 1;
+	set_alien_speed(ALIEN_SPEED(steps_per_move));
+	set_projectile_speeds(PROJECTILE_SPEED(steps_per_move), 
+			PROJECTILE_SPEED(steps_per_move));
+}
+
+// Set up the things that happen regularly during the game (see
+// scheduler.h). Tasks due at the same time run in this order - in
+// particular the aliens move before the background scrolls.
+void start_game_tasks(void) {
+	init_scheduler();
+	alien_add_task = scheduler_add_task(try_to_add_alien, 
+			get_level_alien_add_ms());
+	alien_move_task = scheduler_add_task(move_aliens, 
+			get_level_alien_move_ms());
+	scroll_task = scheduler_add_task(scroll_game_background, 
+			get_level_alien_move_ms());
+	scheduler_add_task(advance_projectiles, 300);
+	tasks_level = get_level();
+	set_game_speeds();
+	set_game_clock_running(!paused);
+}
+
+// Pace the alien and background tasks for the current level's design
+void set_level_task_periods(void) {
+	scheduler_set_period(alien_add_task, get_level_alien_add_ms());
+	scheduler_set_period(alien_move_task, get_level_alien_move_ms());
+	scheduler_set_period(scroll_task, get_level_alien_move_ms());
+	tasks_level = get_level();
+}
+
+// Task to scroll the background (as many columns as the aliens step)
+void scroll_game_background(void) {
+	for(uint8_t i = 0; i < steps_per_move; i++) {
+		scroll_background();
+	}
+}
+
+// Task to add an alien (if there is room for one)
+void try_to_add_alien(void) {
+	(void)add_alien_to_game();
+}
+
+// Put the CPU to sleep until there is something to do. Timer 1 is set to
+// wake us when the next timed thing is due (see time_until_next_work()) -
+// input, the LED matrix link and the seven segment display refresh wake us
+// too. While playing we look for work each time we wake and go back to
+// sleep if there is none. Otherwise we return after every wake up so the
+// current state can check for button pushes and serial input.
+void wait_for_work(void) {
+	while(1) {
+		// Input latency is timed to when the LED matrix link has sent
+		// everything - checked each time its interrupts wake us
+		input_check_sent();
+		cli();
+		if(game_state == STATE_PLAYING && (input_waiting() || 
+				ledmatrix_has_unsent() || 
+				(get_alien_steering() && !flow_field_settled()))) {
+			sei();
+			return;
+		}
+		uint32_t until = time_until_next_work();
+		if(until == 0) {
+			sei();
+			return;
+		}
+		if(until != UINT32_MAX) {
+			set_wakeup_time(get_current_time() + until);
+		}
+		idle_until_interrupt();
+		if(game_state != STATE_PLAYING) {
+			return;
+		}
+	}
+}
+
+// Return the number of milliseconds until the current state has something
+// to do at a set time - 0 if it has now, UINT32_MAX if it has nothing
+uint32_t time_until_next_work(void) {
+	int32_t until;
+	switch(game_state) {
+		case STATE_PLAYING:
+			return scheduler_time_until_next_task();
+		case STATE_SPLASH:
+		case STATE_LEVEL_UP:
+			return scrolling_display_time_until_column();
+		case STATE_STARTING:
+		case STATE_DYING:
+			until = state_end_time - get_current_time();
+			return (until > 0) ? until : 0;
+		default:
+			return UINT32_MAX;
+	}
+}
+
+// Carry out an input action (see input.h). Only pausing, starting a new
+// game and the options/reports work while the game is paused. Returns 1
+// if the player moved or a projectile was fired, 0 otherwise.
+uint8_t handle_input_event(uint8_t action) {
+	uint8_t player_before = get_player_position();
+	uint16_t projectiles_before = compositor_get_row(LAYER_PROJECTILES, 
+			GET_Y_POSITION(player_before));
+	
+	if (!paused) {
+		switch(action) {
+			case INPUT_FIRE:
+				fire_projectile_if_possible();
+				projectile_sound();
+				break;
+			case INPUT_LEFT:
+				move_player_left();
+				break;
+			case INPUT_RIGHT:
+				move_player_right();
+				break;
+			case INPUT_DOWN:
 				move_player_down();
+				break;
+			case INPUT_UP:
+				move_player_up();
+				break;
+			case INPUT_DOUBLE_SPEED:
+				increment_double_speed(); // increment the speed mode
+				set_game_speeds();
+				move_cursor(10, 13);
+				if (get_double_speed() % 2 == 0) { // if the speed mode is even
+					printf_P(PSTR("DOUBLE SPEED MODE")); // print double speed mode
+				} else {
+					printf_P(PSTR("                   ")); // otherwise clear
+					PORTD ^= (1 << 6); // turn off decimal point
+				}
+				break;
 		}
-		
 	}
-	x_y_axis ^= 1;
+
+	if (action == INPUT_NEW_GAME) {
+		new_game();
+	} else if (action == INPUT_PAUSE) {
+		paused = !paused;
+		set_game_clock_running(!paused);
+
+		if (paused) {
+			set_display_attribute(FG_GREEN);
+			set_display_attribute(TERM_BRIGHT);
+			move_cursor(10,16);
+			printf_P(PSTR("Paused"));
+			normal_display_mode();
+			move_cursor(10,17);
+		} else {
+			move_cursor(10,16);
+			printf_P(PSTR("       "));
+			move_cursor(10,17);
+		}
+	} else if (action == INPUT_STEERING) {
+		// Toggle alien steering (aliens chase the player)
+		set_alien_steering(!get_alien_steering());
+		move_cursor(10, 14);
+		if(get_alien_steering()) {
+			init_flow_field();
+			printf_P(PSTR("SMART ALIENS"));
+		} else {
+			printf_P(PSTR("            "));
+		}
+	} else if (action == INPUT_SHOW_SPI_USAGE) {
+		// Show LED matrix bandwidth usage
+		show_spi_usage();
+	} else if (action == INPUT_SHOW_LATENCY) {
+		show_input_latency();
+	} else if (action == INPUT_SHOW_CPU_USAGE) {
+		// Show how busy the CPU has been since this was last shown
+		move_cursor(10,19);
+		printf_P(PSTR("CPU busy %u%%   "), get_busy_percent());
+		reset_busy_percent();
+	}
+	
+	return get_player_position() != player_before || 
+			compositor_get_row(LAYER_PROJECTILES, GET_Y_POSITION(player_before)) != 
+			projectiles_before;
 }
 
+// Print how long input takes to show up on the LED matrix
+void show_input_latency(void) {
+	InputLatency latency;
+
+	input_get_latency(&latency);
+	move_cursor(10,18);
+	if (latency.count == 0) {
+		printf_P(PSTR("Input latency: no input shown yet   "));
+	} else {
+		printf_P(PSTR("Input latency: %lu events, min %u avg %lu max %u ms   "),
+				latency.count, latency.min, latency.total / latency.count, latency.max);
+	}
+}
 
 void splash_screen(void) {
 	// Reset display attributes and clear terminal screen then output a message
@@ -231,21 +537,50 @@ void splash_screen(void) {
 	set_display_attribute(FG_GREEN);	// Make the text green
 	printf_P(PSTR("CSSE2010/7201 project by Sebastian Narloch (44345714)"));	
 	set_display_attribute(FG_WHITE);	// Return to default colour (White)
-	
-	// Output the scrolling message to the LED matrix
-	// and wait for a push button to be pushed.
+	move_cursor(3,7);
+	printf_P(PSTR("Press c to calibrate the LED matrix link (now divider %d, gap %dus)"), 
+			link_tuning_get_divider(), link_tuning_get_gap());
+	move_cursor(3,8);
+	printf_P(PSTR("Press j to calibrate the joystick (leave it centred)"));
+	
+	// Output the scrolling message to the LED matrix. It is scrolled by
+	// splash_screen_service() until a push button is pushed.
+	ledmatrix_set_subsystem(LEDMATRIX_SUBSYSTEM_SCROLLER);
 	ledmatrix_clear();
-	while(1) {
-		set_scrolling_display_text("SPACE IMPACT  SEBASTIAN NARLOCH 44345714", COLOUR_ORANGE);
-		// Scroll the message until it has scrolled off the 
-		// display or a button is pushed. We pause for 130ms between each scroll.
-		while(scroll_display()) {
-			_delay_ms(130);
-			if(button_pushed() != NO_BUTTON_PUSHED || serial_input_available()) {
-				clear_serial_input_buffer();
-				return;
-			}
+	start_scrolling_display(MARQUEE_SPLASH, COLOUR_ORANGE, SCROLLING_DISPLAY_MS_PER_COLUMN);
+	game_state = STATE_SPLASH;
+}
+
+void splash_screen_service(void) {
+	// Scroll the message in the background (starting it again each 
+	// time it has scrolled off the display) until a button is pushed
+	// or a key is pressed - then start the game.
+	scrolling_display_service();
+	if(scrolling_display_finished()) {
+		start_scrolling_display(MARQUEE_SPLASH, COLOUR_ORANGE, SCROLLING_DISPLAY_MS_PER_COLUMN);
+	}
+	if(joystick_finish_calibration()) {
+		show_joystick_calibration();
+	}
+	if(serial_input_available()) {
+		char c = fgetc(stdin);
+		if(c == 'c') {
+			calibrate_led_matrix_link();
+			return;
+		} else if(c == 'j') {
+			move_cursor(3,8);
+			printf_P(PSTR("Calibrating joystick...                              "));
+			joystick_start_calibration();
+			return;
 		}
+		cancel_scrolling_display();
+		clear_serial_input_buffer();
+		new_game();
+		return;
+	}
+	if(button_pushed() != NO_BUTTON_PUSHED) {
+		cancel_scrolling_display();
+		new_game();
 	}
 } 
   
@@ -257,6 +592,7 @@ void new_game(void) {
 	init_aliens();
 	init_projectiles();
 	init_player();
+	init_flow_field();
 
 	
 	// Clear the serial terminal
@@ -271,232 +607,97 @@ void new_game(void) {
 	show_lives();
 	
 		
-	// Clear a button push or serial input if any are waiting
-	// (The cast to void means the return value is ignored.)
-	(void)button_pushed();
-	clear_serial_input_buffer();
+	// Clear any button pushes or serial input that are waiting
+	init_input();
+	
+	// Show the initial background and player
+	compositor_render();
 	
-	// Delay for half a second
-	_delay_ms(500);
+	// Play starts in half a second (see main())
+	state_end_time = get_current_time() + 500;
+	game_state = STATE_STARTING;
 }
 
-void play_game(void) {
-	uint32_t current_time, last_move_time, last_alien_add_time, last_alien_move_time;
-	uint32_t last_projectile_move_time;
-	int8_t button;
-	char serial_input, escape_sequence_char;
-	uint8_t characters_into_escape_sequence = 0;
+// Return 1 if play should carry on, 0 if the player has died, a new game
+// has been started or the level up message is showing
+uint8_t still_playing(void) {
+	return game_state == STATE_PLAYING && !is_player_dead() && 
+			!level_up_screen_showing();
+}
 
-	
-	
-	// Get the current time and remember this as the last time any of our events
-	// happened.
-	current_time = get_current_time();
-	last_move_time = current_time;
-	last_alien_add_time = current_time;
-	last_alien_move_time = current_time;
-	last_projectile_move_time = current_time;
-	
-	// We play the game while the player isn't dead
-	while(!is_player_dead()) {
-	
-		// Check for input - which could be a button push or serial input.
-		// Serial input may be part of an escape sequence, e.g. ESC [ D
-		// is a left cursor key press. We will be processing each character
-		// independently and can't do anything until we get the third character.
-		// At most one of the following three variables will be set to a value 
-		// other than -1 if input is available.
-		// (We don't initalise button to -1 since button_pushed() will return -1
-		// if no button pushes are waiting to be returned.)
-		// Button pushes take priority over serial input. If there are both then
-		// we'll retrieve the serial input the next time through this loop
-		serial_input = -1;
-		escape_sequence_char = -1;
-		button = button_pushed();
-		
-		if(button == -1) {
-			// No push button was pushed, see if there is any serial input
-			if(serial_input_available()) {
-				// Serial data was available - read the data from standard input
-				serial_input = fgetc(stdin);
-				// Check if the character is part of an escape sequence
-				if(characters_into_escape_sequence == 0 && serial_input == ESCAPE_CHAR) {
-					// We've hit the first character in an escape sequence (escape)
-					characters_into_escape_sequence++;
-					serial_input = -1; // Don't further process this character
-				} else if(characters_into_escape_sequence == 1 && serial_input == '[') {
-					// We've hit the second character in an escape sequence
-					characters_into_escape_sequence++;
-					serial_input = -1; // Don't further process this character
-				} else if(characters_into_escape_sequence == 2) {
-					// Third (and last) character in the escape sequence
-					escape_sequence_char = serial_input;
-					serial_input = -1;  // Don't further process this character - we
-										// deal with it as part of the escape sequence
-					characters_into_escape_sequence = 0;
-				} else {
-					// Character was not part of an escape sequence (or we received
-					// an invalid second character in the sequence). We'll process 
-					// the data in the serial_input variable.
-					characters_into_escape_sequence = 0;
-				}
-			}
-		}
-		
-		
-		if (!paused) {
-			// Process the input.
-			if(button==3 || serial_input == ' ') {
-				// Button 3 pressed or space bar
-				fire_projectile_if_possible();
-				projectile_sound();
-				} else if (escape_sequence_char=='D') {
-				// Left cursor key escape sequence received
-				move_player_left();
-				} else if(escape_sequence_char=='C') {
-				// Right cursor key
-				move_player_right();
-				} else if(button == 0 ||escape_sequence_char=='B') {
-				// Button 0 or down cursor key pressed - attempt to move down
-				move_player_down();
-				} else if(button == 1 || escape_sequence_char=='A') {
-				// Button 1 or up cursor key pressed - attempt to move up
-				move_player_up();
-				} else if(button == 2) {
-					increment_double_speed(); // increment the speed mode
-					if (get_double_speed() % 2 == 0) { // if the speed mode is even
-						move_cursor(10, 13);
-						printf_P(PSTR("DOUBLE SPEED MODE")); // print double speed mode
-					} else if (get_double_speed() % 2 == 1) {
-						move_cursor(10, 13);
-						printf_P(PSTR("                   ")); // otherwise clear	
-						PORTD ^= (1 << 6); // turn off decimal point
-					}
-				} else if (serial_input == 'n' || serial_input == 'N') {
-					new_game();
-				} 
-		}
-		
-		if(serial_input == 'p' || serial_input == 'P') {
-			paused = !paused;
-			
-			if (paused) {
-				set_display_attribute(FG_GREEN);
-				set_display_attribute(TERM_BRIGHT);
-				move_cursor(10,16);
-				printf_P(PSTR("Paused"));
-				normal_display_mode();
-				move_cursor(10,17);
-			} else {
-				move_cursor(10,16);
-				printf_P(PSTR("       "));
-				move_cursor(10,17);
-			}
-		}
-		
-		if (paused) {
-			if (serial_input == 'n' || serial_input == 'N') {
-				new_game();
-			}
+// Do one pass of the game - called each time through the main loop while
+// we're playing
+void play_game(void) {
+	InputEvent event;
+	
+	// Deal with every input event that has come in since we were last
+	// here - button pushes, serial input and joystick movements. (If
+	// play stops the rest are left for later.)
+	while(still_playing() && input_next_event(&event)) {
+		if(handle_input_event(event.action)) {
+			input_measure_latency(&event);
 		}
-		
+	}
 
-		current_time = get_current_time();
-		if(!is_player_dead() && !paused &&  get_double_speed() % 2 == 1) {
-			if (current_time >= last_move_time + 650) {
-				// 600ms (0.6 second) has passed since the last time we scrolled
-				// the background, so scroll it now and check whether that means
-				// we've finished the level. (If a crash occurs we will drop out of 
-				// the main while loop so we don't need to check for that here.
-				scroll_background(); // stopped working for some reason, had to put in move_alien
-				last_move_time = current_time;
-			}
-			
-			// joystick
-			if(current_time > last_move_time + 200) {
-				joystick_functionality();
-				last_move_time = current_time;
-			}
-			if(current_time > last_alien_add_time + 1000) {
-				// 1 second has passed since the last time we tried to add an 
-				// alien - so try now
-				add_alien_to_game();
-				last_alien_add_time = current_time;
-			}
-			if(current_time > last_alien_move_time + 400) {
-				// 400ms has passed since the last time we tried to move an 
-				// alien - so try now
-				move_random_alien();
-				scroll_background();
-				last_alien_move_time = current_time;
-			}
-			if(current_time > last_projectile_move_time + 300) {
-				// 300ms has passed since the last projecile move - try now
-				advance_projectiles();
-				last_projectile_move_time = current_time;
-			}
-		}
-		
+	if(get_level() != tasks_level) {
+		// We've gone up a level - the new level may move at a different pace
+		set_level_task_periods();
+	}
+
+	if(still_playing()) {
+		// Scroll the background, add and move aliens and move projectiles if
+		// it's time to (see start_game_tasks()). Nothing happens while the
+		// game is paused.
+		scheduler_run();
+	}
 	
-		else if (!is_player_dead() && !paused && get_double_speed() % 2 == 0) {
+	if(game_state != STATE_PLAYING) {
+		// A new game has been started
+		return;
+	}
+	if(level_up_screen_showing()) {
+		// The level up message is on the LED matrix - the game waits (and
+		// isn't drawn) until it has gone
+		set_game_clock_running(0);
+		game_state = STATE_LEVEL_UP;
+		return;
+	}
 	
-			if(current_time > last_move_time + 300) {
-				// 300ms (0.3 second) has passed since the last time we scrolled
-				// the background, so scroll it now and check whether that means
-				// we've finished the level. (If a crash occurs we will drop out of
-				// the main while loop so we don't need to check for that here.)
-				
-				scroll_background();
-				last_move_time = current_time;
-			}
-			
-			// joystick
-			if(current_time >= last_move_time + 200) {
-				joystick_functionality();
-				last_move_time = current_time;
-			}
-			
-			if(current_time > last_alien_add_time + 1000) {
-				// 1 second has passed since the last time we tried to add an
-				// alien - so try now
-				add_alien_to_game();
-				last_alien_add_time = current_time;
-			}
-			if(current_time > last_alien_move_time + 200) {
-				// 400ms has passed since the last time we tried to move an
-				// alien - so try now
-				move_random_alien();
-				scroll_background();
-				last_alien_move_time = current_time;
-			}
-			if(current_time > last_projectile_move_time + 150) {
-				// 300ms has passed since the last projecile move - try now
-				advance_projectiles();
-				last_projectile_move_time = current_time;
-			}
-			
-		}
+	if(get_alien_steering()) {
+		// Keep the aliens' flow field up to date (a little at a time). This
+		// comes after anything that might have moved so that every change
+		// is seen before we next sleep.
+		flow_field_update();
 	}
-	handle_death();
 	
+	// Send everything drawn this time through the loop to the LED matrix.
+	// (Latency measurements finish once it has all gone - see
+	// wait_for_work().)
+	compositor_render();
+	
+	if(is_player_dead()) {
+		handle_death();
+	}
 }
 
+// Show the level up message until a button is pushed or a key is pressed,
+// then carry on with the game on the new level
+void level_up(void) {
+	level_up_screen_service();
+	if(!level_up_screen_showing()) {
+		set_level_task_periods();
+		set_game_clock_running(!paused);
+		game_state = STATE_PLAYING;
+	}
+}
 
+// Wait for a button push after the game is over, then start again
 void handle_game_over() {
-	if (lives == 1) {
-		reset_level_counter();
-		move_cursor(10,14);
-		// Print a message to the terminal.
-		printf_P(PSTR("GAME OVER"));
-		move_cursor(10,15);
-		printf_P(PSTR("Press a button to start again"));
-		while(button_pushed() == -1) {
-			; // wait until a button has been pushed
-		}
+	if(button_pushed() != NO_BUTTON_PUSHED) {
 		lives = 4;
 		init_health_bar();
-	} else {
-		lives -= 1;
+		update_serial();
+		show_lives();
+		new_game();
 	}
-	
 }
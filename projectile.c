@@ -6,7 +6,7 @@
  */ 
 
 #include "projectile.h"
-#include "ledmatrix.h"
+#include "compositor.h"
 #include "pixel_colour.h"
 #include "game_position.h"
 #include "game_background.h"
@@ -20,20 +20,32 @@
 
 
 ///////////////////////////////// Global variables //////////////////////
-// Projectiles just occupy a single pixel - unlikely there can ever be more than 64
-#define MAX_PROJECTILES 64
-static uint8_t num_projectiles;
-static uint8_t projectile_position[MAX_PROJECTILES];
+// Projectiles just occupy a single pixel and all move together, so we don't
+// keep a list of them. The projectile layers of the compositor are the record
+// of where they are - bit x of row y is set if there is a projectile at
+// (x,y). This means that all the projectiles in a row can be moved and 
+// checked for collisions at once. LAYER_PROJECTILES has those fired by the
+// player and LAYER_ALIEN_PROJECTILES those fired by aliens.
+
+// The speed of each owner's projectiles (8.8 fixed point pixels per advance
+// - see projectile.h). An owner's projectiles always move together, so they
+// also share the fractional part of their position - how far they have got
+// towards the next pixel.
+static uint16_t player_projectile_speed = PROJECTILE_SPEED(1);
+static uint16_t alien_projectile_speed = PROJECTILE_SPEED(1);
+static uint8_t player_projectile_fraction;
+static uint8_t alien_projectile_fraction;
 
 // Colours
-#define COLOUR_PROJECTILE	COLOUR_ORANGE
+#define COLOUR_PROJECTILE		COLOUR_ORANGE
+#define COLOUR_ALIEN_PROJECTILE	COLOUR_LIGHT_GREEN
 
 /////////////////////////////// Function Prototypes for Helper Functions ///////
 // These functions are defined after the public functions. Comments are with the
 // definitions. These functions are static, so not accessible outside this file.
-static void remove_projectile(uint8_t projectile_number);
-static void erase_projectile(uint8_t projectile_number);
-static void redraw_projectile(uint8_t projectile_number);
+static uint8_t step_projectiles(uint8_t move_player_projectiles, 
+		uint8_t move_alien_projectiles);
+static void score_hit(void);
 		
 /////////////////////////////// Public Functions ///////////////////////////////
 // These functions are defined in the same order as declared in projectile.h. See
@@ -41,7 +53,17 @@ static void redraw_projectile(uint8_t projectile_number);
 
 // Initialise projectile data
 void init_projectiles(void) {
-	num_projectiles = 0;
+	compositor_clear_layer(LAYER_PROJECTILES);
+	compositor_clear_layer(LAYER_ALIEN_PROJECTILES);
+	compositor_set_layer_colour(LAYER_PROJECTILES, COLOUR_PROJECTILE);
+	compositor_set_layer_colour(LAYER_ALIEN_PROJECTILES, COLOUR_ALIEN_PROJECTILE);
+	player_projectile_fraction = 0;
+	alien_projectile_fraction = 0;
+}
+
+void set_projectile_speeds(uint16_t player_speed, uint16_t alien_speed) {
+	player_projectile_speed = player_speed;
+	alien_projectile_speed = alien_speed;
 }
 
 void fire_projectile_if_possible(void) {
@@ -58,140 +80,172 @@ void fire_projectile_if_possible(void) {
 		// Background to right - can't fire projectile
 		return;
 	}
-	if(is_projectile_at(position_to_right_of_player)) {
-		// There is a projectile to the immediate right of the player - can't fire
-		return;
-	}
-	if(playerX <= 12 && is_projectile_at(position_to_right_of(position_to_right_of_player))) {
-		// There is a projectile two pixels to the right of the player - can't fire
+	// Can't fire if there is a projectile in either of the two pixels to
+	// the right of the player
+	uint16_t row = compositor_get_row(LAYER_PROJECTILES, GET_Y_POSITION(get_player_position()));
+	if(row & (3U << (playerX + 2))) {
 		return;
 	}
 	int8_t alien_num = alien_at(position_to_right_of_player);
 	if(alien_num != -1) {
 		// There is an alien to the right of the player - we can fire, but we
 		// won't see the projectile. Indicate that the alien has been hit.
+		// The projectile is used up by the hit.
 		alien_hit_at(alien_num, position_to_right_of_player);
-		if (get_double_speed() % 2 == 0) {
-			add_to_score(0x02);
-		} else {
-			add_to_score(0x01);
-		}
-		update_serial();
-		
+		score_hit();
+		return;
 	}
 	
 	// Can fire projectile - add one to the immediate right of the player
-	// and draw it on the display
-	uint8_t new_projectile_number = num_projectiles;
-	num_projectiles++;
-	projectile_position[new_projectile_number] = position_to_right_of_player;
-	redraw_projectile(new_projectile_number);
+	compositor_set_pixel(LAYER_PROJECTILES, playerX + 2, 
+			GET_Y_POSITION(get_player_position()));
+}
+
+void fire_alien_projectile(uint8_t position) {
+	uint8_t x = GET_X_POSITION(position);
+	uint8_t y = GET_Y_POSITION(position);
+	if(y > 7) {
+		// Invalid position (e.g. the alien is at the left hand edge)
+		return;
+	}
+	uint16_t occupied = compositor_get_row(LAYER_BACKGROUND, y) |
+			compositor_get_row(LAYER_ALIENS, y) |
+			compositor_get_row(LAYER_PROJECTILES, y) |
+			compositor_get_row(LAYER_ALIEN_PROJECTILES, y);
+	if(occupied & (1U << x)) {
+		return;
+	}
+	compositor_set_pixel(LAYER_ALIEN_PROJECTILES, x, y);
+	check_if_player_is_dead();
 }
 
 void advance_projectiles(void) {
-	// Remove all the projectiles from the display
-	// Iterate over all the projectiles and move them all to the right.
-	uint8_t projectile_num = 0;
-	while(projectile_num < num_projectiles) {
-		// Determine the new position and check what is in that position
-		// Note that we generate this new position, but the result is only valid
-		// if the projectile is NOT in column 15 - so we check that first and only
-		// use this value if that is the case.
-		uint8_t new_projectile_posn = position_to_right_of(projectile_position[projectile_num]);
-		if(GET_X_POSITION(projectile_position[projectile_num]) == 15) {
-			// Projectile is at right hand edge - just remove it
-			remove_projectile(projectile_num);
-		} else if(is_background_at(new_projectile_posn)) {
-			// Projectile has run into background - remove it 
-			remove_projectile(projectile_num);
-		} else {
-			int8_t alien_num = alien_at(new_projectile_posn);
-			if(alien_num != -1) {
-				// Indicate that we've hit an alien and remove the projectile
-				alien_hit_at(alien_num, new_projectile_posn);
-				if (get_double_speed() % 2 == 0) {
-					add_to_score(0x02);
-				}
-				else {
-					add_to_score(0x01);
-				}
-				
-				update_serial();
-				remove_projectile(projectile_num);
-			} else if(new_projectile_posn == get_player_position()) {
-				// Player is at this position - just remove the projectile
-				remove_projectile(projectile_num);
-			} else {
-				// Nothing at this position - move the projectile forward
-				erase_projectile(projectile_num);
-				projectile_position[projectile_num] = new_projectile_posn;
-				redraw_projectile(projectile_num);
-				// Move on to the next projectile number
-				projectile_num++;
-			
-				// Note that in other cases, because we have removed a projectile,
-				// this spot in the projectile position array will have been filled
-				// with the details of another projectile (unless it was the last one).
-				// We don't need to increment the projectile_num.
-			}
+	// Work out how many pixels each owner's projectiles move this time
+	uint16_t player_travel = player_projectile_fraction + player_projectile_speed;
+	uint16_t alien_travel = alien_projectile_fraction + alien_projectile_speed;
+	uint8_t player_steps = player_travel >> 8;
+	uint8_t alien_steps = alien_travel >> 8;
+	player_projectile_fraction = player_travel & 0xFF;
+	alien_projectile_fraction = alien_travel & 0xFF;
+	
+	// Move a pixel at a time, checking for collisions at each one
+	uint8_t player_hit = 0;
+	while(player_steps || alien_steps) {
+		player_hit |= step_projectiles(player_steps != 0, alien_steps != 0);
+		if(player_steps) {
+			player_steps--;
+		}
+		if(alien_steps) {
+			alien_steps--;
 		}
 	}
+	if(player_hit) {
+		check_if_player_is_dead();
+	}
 }
 
 // Return 1 if there is a projectile at the given position, 0 otherwise
 uint8_t is_projectile_at(uint8_t position) {
-	// Check each projectile
-	for(uint8_t i = 0 ; i < num_projectiles; i++) {
-		if(projectile_position[i] == position) {
-			return 1;
-		}
-	}
-	return 0;
+	return compositor_is_set_at(LAYER_PROJECTILES, position);
 }
 
 // Remove any projectile at the given position.
 void remove_any_projectile_at(uint8_t position) {
-	// Check each projectile
-	for(uint8_t i = 0; i < num_projectiles; i++) {
-		if(projectile_position[i] == position) {
-			// Found one - remove it and return - no need to check other positions
-			remove_projectile(i);
-			return;
-		}
+	if(is_projectile_at(position)) {
+		compositor_clear_pixel(LAYER_PROJECTILES, GET_X_POSITION(position), 
+				GET_Y_POSITION(position));
 	}
 }
 
-// Remove the projectile from the game. Usually because it has hit something.
-static void remove_projectile(uint8_t projectile_number) {
-	// Remove the projectile from the display
-	erase_projectile(projectile_number);
-	// Rearrange our array of projectile positions so that there is no hole
-	// in the array. If this projectile was not the last one in the array, we
-	// just move the last projectile into this position.
-	uint8_t last_projectile_num = num_projectiles - 1;
-	if(projectile_number != last_projectile_num) {
-		projectile_position[projectile_number] = projectile_position[last_projectile_num];
+// Remove any projectiles (from the player or aliens) in the given columns
+// (bit x set for column x) of row y
+void remove_projectiles_in_row(uint8_t y, uint16_t columns) {
+	uint16_t row = compositor_get_row(LAYER_PROJECTILES, y);
+	if(row & columns) {
+		compositor_set_row(LAYER_PROJECTILES, y, row & ~columns);
+	}
+	row = compositor_get_row(LAYER_ALIEN_PROJECTILES, y);
+	if(row & columns) {
+		compositor_set_row(LAYER_ALIEN_PROJECTILES, y, row & ~columns);
 	}
-	// else projectile was the last one in the array
-	
-	// Shorten our array
-	num_projectiles -= 1;
 }
 
-//////////////////////// REDRAWING FUNCTIONS /////////////////////////////////
-
-// Erase the given projectile from the display
-static void erase_projectile(uint8_t projectile_number) {
-	uint8_t x = GET_X_POSITION(projectile_position[projectile_number]);
-	uint8_t y = GET_Y_POSITION(projectile_position[projectile_number]);
-	
-	ledmatrix_update_pixel(x, y, COLOUR_BLACK);
+// Move the player's projectiles one pixel to the right and/or the aliens'
+// projectiles one pixel to the left and deal with any collisions. Returns 1
+// if a projectile from an alien has hit the player.
+static uint8_t step_projectiles(uint8_t move_player_projectiles, 
+		uint8_t move_alien_projectiles) {
+	uint8_t player_position = get_player_position();
+	uint8_t player_hit = 0;
+	for(uint8_t y = 0; y <= 7; y++) {
+		uint16_t row = compositor_get_row(LAYER_PROJECTILES, y);
+		uint16_t alien_row = compositor_get_row(LAYER_ALIEN_PROJECTILES, y);
+		if(!(row | alien_row)) {
+			continue;
+		}
+		// Move all the player's projectiles in this row one to the right 
+		// and/or the aliens' projectiles one to the left. Any that were at the
+		// edge go off the game field and disappear.
+		uint16_t passing = 0;
+		if(move_player_projectiles && move_alien_projectiles) {
+			// Projectiles next to each other will pass each other. (This is
+			// where the player's projectile ends up.)
+			passing = (row << 1) & alien_row;
+		}
+		if(move_player_projectiles) {
+			row <<= 1;
+		}
+		if(move_alien_projectiles) {
+			alien_row >>= 1;
+		}
+		// Projectiles heading towards each other that pass each other or 
+		// end up in the same place destroy each other
+		uint16_t meeting = row & alien_row;
+		row &= ~(meeting | passing);
+		alien_row &= ~(meeting | (passing >> 1));
+		// Projectiles that run into the background are removed. Projectiles
+		// from aliens are also stopped by aliens.
+		row &= ~compositor_get_row(LAYER_BACKGROUND, y);
+		alien_row &= ~(compositor_get_row(LAYER_BACKGROUND, y) | 
+				compositor_get_row(LAYER_ALIENS, y));
+		if(y == GET_Y_POSITION(player_position)) {
+			// A player's projectile that runs into the player is just removed. 
+			// One from an alien kills the player. 
+			row &= ~(1U << GET_X_POSITION(player_position));
+			if(alien_row & (3U << GET_X_POSITION(player_position))) {
+				player_hit = 1;
+			}
+		}
+		// The player's projectiles that run into an alien hit it and are removed
+		uint16_t hits = row & compositor_get_row(LAYER_ALIENS, y);
+		row &= ~hits;
+		for(uint8_t x = 0; hits; x++) {
+			if(!(hits & (1U << x))) {
+				continue;
+			}
+			hits &= ~(1U << x);
+			int8_t alien_num = alien_at(GAME_POSITION(x, y));
+			if(alien_num != -1) {
+				alien_hit_at(alien_num, GAME_POSITION(x, y));
+				score_hit();
+			} else {
+				// An earlier hit has destroyed the alien that was here, so
+				// the projectile carries on into the space it has left
+				row |= (1U << x);
+			}
+		}
+		compositor_set_row(LAYER_PROJECTILES, y, row);
+		compositor_set_row(LAYER_ALIEN_PROJECTILES, y, alien_row);
+	}
+	return player_hit;
 }
 
-// Redraw the given projectile
-static void redraw_projectile(uint8_t projectile_number) {
-	uint8_t x = GET_X_POSITION(projectile_position[projectile_number]);
-	uint8_t y = GET_Y_POSITION(projectile_position[projectile_number]);
-		
-	ledmatrix_update_pixel(x, y, COLOUR_PROJECTILE);
-}
\ No newline at end of file
+// Add to the score for a projectile hitting an alien (more at double speed)
+static void score_hit(void) {
+	if (get_double_speed() % 2 == 0) {
+		add_to_score(0x02);
+	} else {
+		add_to_score(0x01);
+	}
+	update_serial();
+}
@@ -9,26 +9,57 @@
 
 #include <stdint.h>
 
+// Projectiles are fired by the player (and travel right) or by aliens (and
+// travel left). Each is kept in its own compositor layer - the layer is 
+// the projectile's owner tag, and the owner decides the direction.
+
+// Projectile speeds are given in pixels per call of advance_projectiles()
+// as 8.8 fixed point numbers - i.e. PROJECTILE_SPEED(1) is one pixel each 
+// time, 0x0180 is 1.5 pixels (one pixel, then two, then one...).
+#define PROJECTILE_SPEED(pixels)	((uint16_t)(pixels) << 8)
+
 // Initialise projectile data (no projectiles to start with)
 void init_projectiles(void);
 
+// Set the speed of the projectiles fired by the player and by aliens 
+// (see PROJECTILE_SPEED above). Both are initially 1 pixel.
+void set_projectile_speeds(uint16_t player_speed, uint16_t alien_speed);
+
 // Fire a projectile if possible. This will be possible unless there is already
 // a projectile in the one or two pixels to the right of the player, or the
 // player is at the right hand edge of the game field, or there is background
-// to the immediate right.
+// to the immediate right. If there is an alien to the immediate right, it is
+// hit straight away (and no projectile is added).
 void fire_projectile_if_possible(void);
 
-// Move all the projectiles forward. If any collide with the background, they
-// are removed. If any collide with an alien, they reduce the alien's energy
-// (and remove the alien if its energy is 0). If they hit the player, we just
-// remove the projectile (and no damage to the player).
+// Fire a projectile from an alien, starting at the given position (to the
+// left of the alien). Nothing happens if the position is invalid or there is
+// already something there. The player may be dead after this if the 
+// projectile is fired straight into the player.
+void fire_alien_projectile(uint8_t position);
+
+// Move all the projectiles forward by their speed. They move one pixel at 
+// a time, so can't jump over anything. (All those in a row, fired by either
+// the player or aliens, are moved at once so this takes the same time however
+// many projectiles there are.) If any collide with the background, they
+// are removed. If a player's projectile collides with an alien, it reduces 
+// the alien's energy (and removes the alien if its energy is 0). If it hits
+// the player, we just remove the projectile (and no damage to the player).
+// A projectile fired by an alien is stopped by other aliens but kills the
+// player. Projectiles travelling in opposite directions destroy each other.
+// The player may be dead after this.
 void advance_projectiles(void);
 
-// Return 1 if there is a projectile at the given position, 0 otherwise
+// Return 1 if there is a projectile fired by the player at the given 
+// position, 0 otherwise
 uint8_t is_projectile_at(uint8_t position);
 
-// Remove any projectile at the given position. No action taken if there is
-// no projectile at that position
+// Remove any projectile fired by the player at the given position. No action
+// taken if there is no such projectile at that position
 void remove_any_projectile_at(uint8_t position);
 
+// Remove any projectiles (fired by anyone) in row y in the given columns 
+// (bit x is column x)
+void remove_projectiles_in_row(uint8_t y, uint16_t columns);
+
 #endif /* PROJECTILE_H_ */
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+ * scheduler.c
+ *
+ * See scheduler.h for an overview. With only a handful of tasks we keep
+ * them in a small table and check each deadline every time we're called.
+ * The game clock is advanced from the real clock (timer1) each time we
+ * look at it, by the real time that has passed.
+ */
+
+#include <stdint.h>
+
+#include "scheduler.h"
+#include "timer1.h"
+
+typedef struct {
+	SchedulerTask task;
+	uint16_t period;
+	uint32_t deadline;		// game time of its next run
+} ScheduledTask;
+
+static ScheduledTask tasks[SCHEDULER_MAX_TASKS];
+static uint8_t num_tasks;
+
+// The game clock - game_time is updated by update_game_clock() and
+// last_real_time is the real time when that was last done
+static uint32_t game_time;
+static uint32_t last_real_time;
+static uint8_t game_clock_running;
+
+static void update_game_clock(void);
+
+///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
+
+void init_scheduler(void) {
+	num_tasks = 0;
+	game_time = 0;
+	last_real_time = get_current_time();
+	game_clock_running = 1;
+}
+
+uint8_t scheduler_add_task(SchedulerTask task, uint16_t period) {
+	if(num_tasks >= SCHEDULER_MAX_TASKS) {
+		return SCHEDULER_NO_TASK;
+	}
+	update_game_clock();
+	tasks[num_tasks].task = task;
+	tasks[num_tasks].period = period;
+	tasks[num_tasks].deadline = game_time + period;
+	return num_tasks++;
+}
+
+void scheduler_set_period(uint8_t task_id, uint16_t period) {
+	if(task_id < num_tasks) {
+		tasks[task_id].period = period;
+	}
+}
+
+void scheduler_run(void) {
+	update_game_clock();
+	if(!game_clock_running) {
+		return;
+	}
+	for(uint8_t i = 0; i < num_tasks; i++) {
+		ScheduledTask* t = &tasks[i];
+		uint32_t now = game_time;
+		// (The subtraction copes with the clock wrapping around)
+		if((int32_t)(now - t->deadline) < 0) {
+			continue;
+		}
+		t->deadline += t->period;
+		if((int32_t)(now - t->deadline) >= 0) {
+			// We've missed at least one whole period - skip the missed
+			// runs rather than trying to catch up
+			t->deadline = now + t->period;
+		}
+		t->task();
+	}
+}
+
+uint32_t scheduler_time_until_next_task(void) {
+	uint32_t soonest = UINT32_MAX;
+	
+	update_game_clock();
+	if(!game_clock_running) {
+		return soonest;
+	}
+	for(uint8_t i = 0; i < num_tasks; i++) {
+		int32_t until = tasks[i].deadline - game_time;
+		if(until <= 0) {
+			return 0;
+		}
+		if((uint32_t)until < soonest) {
+			soonest = until;
+		}
+	}
+	return soonest;
+}
+
+void set_game_clock_running(uint8_t running) {
+	update_game_clock();
+	game_clock_running = running;
+}
+
+uint32_t get_game_time(void) {
+	update_game_clock();
+	return game_time;
+}
+
+///////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+// Add the real time that has passed to the game clock, if it's running
+static void update_game_clock(void) {
+	uint32_t now = get_current_time();
+	if(game_clock_running) {
+		game_time += now - last_real_time;
+	}
+	last_real_time = now;
+}
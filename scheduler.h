@@ -0,0 +1,56 @@
+/*
+ * scheduler.h
+ *
+ * Runs the game's periodic tasks (scrolling, moving aliens etc.) at a
+ * fixed period each. Tasks run on the game clock, which only moves while
+ * the game is running - so nothing moves on while the game is paused.
+ *
+ * Each task's next deadline is its last deadline plus its period - not
+ * the time it actually ran plus its period - so small delays in the main
+ * loop don't add up. If a task falls a whole period or more behind, the
+ * missed runs are skipped rather than all run at once.
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+// Most tasks that can be added
+#define SCHEDULER_MAX_TASKS 6
+
+// Returned by scheduler_add_task() if there is no room for the task
+#define SCHEDULER_NO_TASK	0xFF
+
+typedef void (*SchedulerTask)(void);
+
+// Remove all tasks and start the game clock again from 0 (running)
+void init_scheduler(void);
+
+// Add a task to be run every period milliseconds of game time, first one
+// period from now. Tasks that are due at the same time run in
+// the order they were added. Returns an ID for the task (or
+// SCHEDULER_NO_TASK if there are too many tasks).
+uint8_t scheduler_add_task(SchedulerTask task, uint16_t period);
+
+// Change how often a task runs. The new period applies from the task's
+// next run.
+void scheduler_set_period(uint8_t task_id, uint16_t period);
+
+// Run every task that is due (each at most once). Should be called
+// frequently (e.g. every time through the game loop).
+void scheduler_run(void);
+
+// Return the number of milliseconds (of real time) until the next task is
+// due - 0 if one is due now, UINT32_MAX if there are no tasks or the game
+// clock is stopped
+uint32_t scheduler_time_until_next_task(void);
+
+// Stop or start the game clock. No tasks run while it is stopped - they
+// carry on from where they were when it starts again.
+void set_game_clock_running(uint8_t running);
+
+// Return the game time in milliseconds
+uint32_t get_game_time(void);
+
+#endif /* SCHEDULER_H_ */
@@ -9,18 +9,18 @@
 
 #include <stdint.h>
 #include "pixel_colour.h"
+#include "marquee_data.h"
 
-/* Sets the text to be displayed and the colour it will be
- * scrolled with. The message will start displaying immediately
- * so will overwrite/interfere with any currently scrolling
+/* Sets the message to be displayed and the colour it will be
+ * scrolled with. Messages are the column data generated from
+ * tools/marquee_messages.txt (e.g. MARQUEE_SPLASH - see marquee_data.h)
+ * and live in program memory. The message will start displaying
+ * immediately so will overwrite/interfere with any currently scrolling
  * message. To avoid this, wait until the scroll_display()
  * function below has returned 0 to indicate the message scrolling
- * is complete. Note that this string is not 
- * copied, so it is important that this string not change
- * after this function is called while the string is still
- * being displayed.
+ * is complete.
  */
-void set_scrolling_display_text(char* string, PixelColour colour);
+void set_scrolling_display_text(const uint8_t* message, PixelColour colour);
 
 /* Scroll the display. Should be called whenever the display
  * is to be scrolled one pixel to the left. It is recommended that
@@ -30,5 +30,25 @@ void set_scrolling_display_text(char* string, PixelColour colour);
  * Returns 1 while a message is still scrolling, 0 when done.
  */
 uint8_t scroll_display(void);
+
+/* Scrolling in the background. start_scrolling_display() sets the
+ * message and a column falls due every ms_per_column milliseconds.
+ * scrolling_display_service() must be called frequently from the main
+ * loop - it scrolls the display once for each column that has fallen due.
+ * scrolling_display_time_until_column() gives the number of milliseconds
+ * until the next column is due (0 if one is due now, UINT32_MAX if no
+ * message is scrolling) so the caller can sleep until then. The message
+ * can be stopped at any time with cancel_scrolling_display().
+ * scrolling_display_finished() returns 1 once the message has scrolled
+ * completely off the display (and 0 if it is still scrolling or was
+ * cancelled).
+ */
+#define SCROLLING_DISPLAY_MS_PER_COLUMN 130
+void start_scrolling_display(const uint8_t* message, PixelColour colour, 
+		uint16_t ms_per_column);
+void scrolling_display_service(void);
+uint32_t scrolling_display_time_until_column(void);
+void cancel_scrolling_display(void);
+uint8_t scrolling_display_finished(void);
 	
 #endif /* SCROLLING_CHAR_DISPLAY_H_ */
\ No newline at end of file
@@ -26,6 +26,8 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
+#include "timer1.h"
+
 /* System clock rate in Hz. (L at the end indicates this is a long constant) */
 #define SYSCLK 8000000L
 
@@ -47,10 +49,12 @@ volatile uint8_t out_insert_pos;
 volatile uint8_t bytes_in_out_buffer;
 
 /* Circular buffer to hold incoming characters. Works on same principle
- * as output buffer
+ * as output buffer. input_time holds the time each character was received
+ * (the low 16 bits of the clock tick count).
  */
 #define INPUT_BUFFER_SIZE 16
 volatile char input_buffer[INPUT_BUFFER_SIZE];
+volatile uint16_t input_time[INPUT_BUFFER_SIZE];
 volatile uint8_t input_insert_pos;
 volatile uint8_t bytes_in_input_buffer;
 volatile uint8_t input_overrun;
@@ -122,6 +126,24 @@ int8_t serial_input_available(void) {
 	return (bytes_in_input_buffer != 0);
 }
 
+uint16_t serial_input_time(void) {
+	/* The pending character is bytes_in_input_buffer characters before
+	 * the insert position (see uart_get_char()). We read both with 
+	 * interrupts off so they match.
+	 */
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	int8_t pos = input_insert_pos - bytes_in_input_buffer;
+	if(pos < 0) {
+		pos += INPUT_BUFFER_SIZE;
+	}
+	uint16_t time = input_time[pos];
+	if(interrupts_enabled) {
+		sei();
+	}
+	return time;
+}
+
 void clear_serial_input_buffer(void) {
 	/* Just adjust our buffer data so it looks empty */
 	input_insert_pos = 0;
@@ -293,6 +315,7 @@ ISR(USART0_RX_vect)
 		/* 
 		 * There is room in the input buffer 
 		 */
+		input_time[input_insert_pos] = (uint16_t)get_current_time();
 		input_buffer[input_insert_pos++] = c;
 		bytes_in_input_buffer++;
 		if(input_insert_pos == INPUT_BUFFER_SIZE) {
@@ -31,6 +31,12 @@ void init_serial_stdio(long baudrate, int8_t echo);
  */
 int8_t serial_input_available(void);
 
+/* Return the time at which the next character waiting to be read from the
+ * serial port was received - the low 16 bits of get_current_time() at the
+ * time. Only meaningful if serial_input_available() is non-zero.
+ */
+uint16_t serial_input_time(void);
+
 /* Discard any input waiting to be read from the serial port. (Characters may
  * have been typed when we didn't want them - clear them.
  */
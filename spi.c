@@ -2,11 +2,166 @@
  * spi.c
  *
  * Author: Peter Sutton
+ *
+ * By default the SPI module is used. If SPI_USE_USART1 is defined when
+ * building, USART1 in Master SPI Mode (MSPIM) is used instead. Its
+ * transmit buffer is double buffered, so the next byte is loaded while
+ * the current one is being shifted out and there is no dead time between
+ * bytes. (With the SPI module nothing is sent while the interrupt handler
+ * loads the next byte.) The same clock dividers are supported, and any
+ * other even divider from 2 to 254 can also be used with USART1.
+ * Estimated (from cycle counts, not measured) time per byte, SPI module
+ * vs USART1: about 1080 vs 1024 cycles at /128, 316 vs 256 at /32 and
+ * 188 vs 128 at /16 - the SPI module's extra cycles being its interrupt
+ * handler.
+ * NOTE: USART1 uses pin D3 (TXD1) for data and pin D4 (XCK1) for the
+ * clock, so the LED matrix must be wired to these pins instead of B5 and
+ * B7 - and the health bar LEDs on those pins must be moved. B4 is still
+ * used as the slave select line.
  */ 
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "spi.h"
 
+// Circular buffers for queued commands - one for each queue. Each command is
+// stored as a length byte followed by the bytes of the command. The
+// interrupt handler takes bytes from head and spi_queue_byte() adds
+// them at tail. committed is the number of bytes (including length bytes)
+// of complete commands available to the interrupt handler - bytes of a
+// command still being added are not counted until spi_queue_end().
+// NOTE - the buffer sizes can not be larger than 255 without changing
+// the types of the variables below. The bulk queue must be large enough
+// to hold a whole display update (130 bytes).
+#define BULK_QUEUE_SIZE		160
+#define URGENT_QUEUE_SIZE	32
+#define NUM_QUEUES			2
+
+static volatile uint8_t bulk_buffer[BULK_QUEUE_SIZE];
+static volatile uint8_t urgent_buffer[URGENT_QUEUE_SIZE];
+static volatile uint8_t* const queue_buffer[NUM_QUEUES] = { bulk_buffer, urgent_buffer };
+static const uint8_t queue_size[NUM_QUEUES] = { BULK_QUEUE_SIZE, URGENT_QUEUE_SIZE };
+
+static volatile uint8_t queue_head[NUM_QUEUES];
+static volatile uint8_t queue_committed[NUM_QUEUES];
+static uint8_t queue_tail[NUM_QUEUES];
+// Bytes added to the command currently being built (and which queue)
+static uint8_t building_queue;
+static uint8_t building_length;
+
+// The queue the byte currently being sent came from, and how many bytes
+// of that command are still to be sent. sending is 0 when the SPI
+// hardware is idle.
+static volatile uint8_t current_queue;
+static volatile uint8_t bytes_left_in_command;
+static volatile uint8_t sending;
+
+// Times spi_queue_begin() has found a queue full. This is kept when the
+// link speed is changed.
+static volatile uint16_t full_count;
+
+// The gap to leave between queued commands (in timer 2 ticks, i.e.
+// microseconds), the clock divider in use, and whether the last byte of a
+// command has just been sent (so a gap is due before the next one)
+static uint8_t command_gap;
+static uint8_t clock_divider;
+static volatile uint8_t gap_due;
+
+static uint8_t take_byte(uint8_t queue);
+static void send_next_byte(void);
+static void start_gap_timer(void);
+static void reset_queues(uint8_t clockdivider);
+
+#ifdef SPI_USE_USART1
+
+// Set when queued bytes have been given to USART1 and we haven't yet
+// checked that they have all been shifted out
+static volatile uint8_t queued_bytes_in_usart;
+
+void spi_setup_master(uint8_t clockdivider) {
+	// Make the SS and XCK1 (clock) pins outputs (pin 4 of port B and
+	// pin 4 of port D). TXD1 becomes an output when the transmitter is
+	// enabled.
+	DDRB |= (1<<4);
+	DDRD |= (1<<4);
+	
+	// Set the slave select (SS) line high
+	PORTB |= (1<<4);
+	
+	// The baud rate register must be zero while the USART is set up
+	UBRR1 = 0;
+	
+	// Master SPI mode (UMSEL1 bits both 1), MSB first, SPI mode 0 to
+	// match the SPI module. Enable the transmitter and receiver (the
+	// receiver is needed for spi_send_byte() to return a value).
+	UCSR1C = (1<<UMSEL11)|(1<<UMSEL10);
+	UCSR1B = (1<<TXEN1)|(1<<RXEN1);
+	
+	// Set the clock. In MSPIM mode the clock is the system clock divided
+	// by 2(UBRR1+1). Invalid values default to the slowest speed the SPI
+	// module supports.
+	if(clockdivider < 2 || (clockdivider & 1)) {
+		clockdivider = 128;
+	}
+	UBRR1 = clockdivider / 2 - 1;
+	
+	reset_queues(clockdivider);
+	queued_bytes_in_usart = 0;
+	
+	// Take SS (slave select) line low
+	PORTB &= ~(1<<4);
+}
+
+uint8_t spi_send_byte(uint8_t byte) {
+	// Wait until everything queued has been sent (the transmit complete
+	// flag is set once the last byte has left the shift register) and
+	// throw away anything received while it was - we only want the byte
+	// received with this one.
+	while(sending) {
+		; // wait
+	}
+	if(queued_bytes_in_usart) {
+		while((UCSR1A & (1<<TXC1)) == 0) {
+			; // wait
+		}
+		queued_bytes_in_usart = 0;
+	}
+	while(UCSR1A & (1<<RXC1)) {
+		(void)UDR1;
+	}
+	
+	// A byte is received as each byte is sent - so when it arrives the
+	// transfer is complete
+	UDR1 = byte;
+	while((UCSR1A & (1<<RXC1)) == 0) {
+		; // wait
+	}
+	return UDR1;
+}
+
+// Start the given byte on its way. USART1 will interrupt when there is
+// room for the next one.
+static void transmit_byte(uint8_t byte) {
+	// Clear the transmit complete flag (by writing a 1 to it) - it will
+	// be set again when this byte and any after it have been sent.
+	UCSR1A |= (1<<TXC1);
+	UDR1 = byte;
+	UCSR1B |= (1<<UDRIE1);
+	queued_bytes_in_usart = 1;
+}
+
+// Nothing left to send - stop the USART interrupting
+static void transmitter_idle(void) {
+	UCSR1B &= ~(1<<UDRIE1);
+}
+
+// Interrupt handler for USART1 data register empty - send the next byte
+ISR(USART1_UDRE_vect) {
+	send_next_byte();
+}
+
+#else
+
 void spi_setup_master(uint8_t clockdivider) {
 	// Set up SPI communication as a master
 	// Make the SS, MOSI and SCK pins outputs. These are pins
@@ -20,7 +175,8 @@ void spi_setup_master(uint8_t clockdivider) {
 	// Set up the SPI control registers SPCR and SPSR:
 	// - SPE bit = 1 (SPI is enabled)
 	// - MSTR bit = 1 (Master Mode)
-	SPCR0 = (1<<SPE0)|(1<<MSTR0);
+	// - SPIE bit = 1 (interrupt on transfer complete - used for queued data)
+	SPCR0 = (1<<SPE0)|(1<<MSTR0)|(1<<SPIE0);
 	
 	// Set SPR0 and SPR1 bits in SPCR and SPI2X bit in SPSR
 	// based on the given clock divider
@@ -50,11 +206,20 @@ void spi_setup_master(uint8_t clockdivider) {
 			break;
 	}
 	
+	reset_queues(clockdivider);
+	
 	// Take SS (slave select) line low
 	PORTB &= ~(1<<4);
 }
 
 uint8_t spi_send_byte(uint8_t byte) {
+	// Wait until everything queued has been sent, then stop the interrupt
+	// handler from seeing this transfer complete.
+	while(sending) {
+		; // wait
+	}
+	SPCR0 &= ~(1<<SPIE0);
+	
 	// Write out the byte to the SPDR0 register. This will initiate
 	// the transfer. We then wait until the most significant byte of
 	// SPSR0 (SPIF0 bit) is set - this indicates that the transfer is
@@ -65,5 +230,171 @@ uint8_t spi_send_byte(uint8_t byte) {
 	while((SPSR0 & (1<<SPIF0)) == 0) {
 		; // wait
 	}
-	return SPDR0;
-}
\ No newline at end of file
+	uint8_t received = SPDR0;
+	SPCR0 |= (1<<SPIE0);
+	return received;
+}
+
+// Start the given byte on its way. The SPI module will interrupt when
+// it has been sent.
+static void transmit_byte(uint8_t byte) {
+	SPDR0 = byte;
+}
+
+// Nothing left to send. (The SPI module only interrupts after a byte has
+// been sent so there is nothing to do.)
+static void transmitter_idle(void) {
+}
+
+// Interrupt handler for SPI transfer complete - send the next byte
+ISR(SPI_STC_vect) {
+	send_next_byte();
+}
+
+#endif /* SPI_USE_USART1 */
+
+void spi_set_command_gap(uint8_t microseconds) {
+	command_gap = microseconds;
+}
+
+// Interrupt handler for the end of a gap between commands - carry on
+// sending
+ISR(TIMER2_COMPA_vect) {
+	TCCR2B = 0;		// stop the timer
+	send_next_byte();
+}
+
+uint8_t spi_queue_begin(uint8_t queue, uint8_t length) {
+	// (The interrupt handler only ever frees up space so it doesn't
+	// matter if it changes queue_committed while we're checking.)
+	if(length > spi_queue_space(queue)) {
+		full_count++;
+		return 0;
+	}
+	building_queue = queue;
+	building_length = 0;
+	spi_queue_byte(length);
+	return 1;
+}
+
+void spi_queue_byte(uint8_t byte) {
+	uint8_t queue = building_queue;
+	queue_buffer[queue][queue_tail[queue]++] = byte;
+	if(queue_tail[queue] == queue_size[queue]) {
+		// Wrap around buffer position if necessary
+		queue_tail[queue] = 0;
+	}
+	building_length++;
+}
+
+void spi_queue_end(void) {
+	// Make the command visible to the interrupt handler, and start
+	// sending if the SPI hardware is idle. Interrupts are turned off
+	// while we do this (and turned back on if they were on).
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	queue_committed[building_queue] += building_length;
+	if(!sending) {
+		send_next_byte();
+	}
+	if(interrupts_were_enabled) {
+		sei();
+	}
+}
+
+uint8_t spi_queue_space(uint8_t queue) {
+	// One byte is needed for the length of the command
+	uint8_t free_bytes = queue_size[queue] - queue_committed[queue];
+	if(free_bytes == 0) {
+		return 0;
+	}
+	return free_bytes - 1;
+}
+
+uint8_t spi_queue_is_idle(uint8_t queue) {
+	return queue_committed[queue] == 0 && 
+			!(sending && current_queue == queue);
+}
+
+uint16_t spi_queue_full_count(void) {
+	return full_count;
+}
+
+// Remove the next byte from the given queue. There must be one.
+static uint8_t take_byte(uint8_t queue) {
+	uint8_t byte = queue_buffer[queue][queue_head[queue]++];
+	if(queue_head[queue] == queue_size[queue]) {
+		queue_head[queue] = 0;
+	}
+	queue_committed[queue]--;
+	return byte;
+}
+
+// Empty the queues and forget any gap in progress
+static void reset_queues(uint8_t clockdivider) {
+	TCCR2B = 0;
+	for(uint8_t queue = 0; queue < NUM_QUEUES; queue++) {
+		queue_head[queue] = 0;
+		queue_tail[queue] = 0;
+		queue_committed[queue] = 0;
+	}
+	bytes_left_in_command = 0;
+	sending = 0;
+	gap_due = 0;
+	clock_divider = clockdivider;
+}
+
+// Start timer 2 counting out the gap between commands. It will interrupt
+// when the gap is over. (The timer counts microseconds - the clock divided
+// by 8.)
+static void start_gap_timer(void) {
+	uint16_t ticks = command_gap;
+#ifdef SPI_USE_USART1
+	// The last byte of the command has only just started being shifted
+	// out, so we add the time this takes (8 bits of divider cycles each).
+	ticks += clock_divider;
+#endif
+	if(ticks > 256) {
+		ticks = 256;
+	}
+	TCNT2 = 0;
+	OCR2A = ticks - 1;
+	TCCR2A = (1<<WGM21);	// CTC mode
+	TIFR2 = (1<<OCF2A);
+	TIMSK2 |= (1<<OCIE2A);
+	TCCR2B = (1<<CS21);		// divide clock by 8
+}
+
+// Start sending the next queued byte (if any). At the end of a command
+// we choose the urgent queue if it has anything waiting - after waiting
+// for the gap between commands if there is one. Must be called with
+// interrupts off.
+static void send_next_byte(void) {
+	if(bytes_left_in_command == 0) {
+		if(gap_due) {
+			// Still sending as far as everyone else is concerned - the
+			// timer interrupt will carry on
+			gap_due = 0;
+			transmitter_idle();
+			start_gap_timer();
+			return;
+		}
+		if(queue_committed[SPI_QUEUE_URGENT]) {
+			current_queue = SPI_QUEUE_URGENT;
+		} else if(queue_committed[SPI_QUEUE_BULK]) {
+			current_queue = SPI_QUEUE_BULK;
+		} else {
+			// Nothing to send
+			sending = 0;
+			transmitter_idle();
+			return;
+		}
+		bytes_left_in_command = take_byte(current_queue);
+	}
+	sending = 1;
+	bytes_left_in_command--;
+	if(bytes_left_in_command == 0 && command_gap) {
+		gap_due = 1;
+	}
+	transmit_byte(take_byte(current_queue));
+}
@@ -2,17 +2,57 @@
  * spi.h
  *
  * Author: Peter Sutton
+ *
+ * Bytes can either be sent one at a time (spi_send_byte(), which busy
+ * waits) or queued for transmission by the SPI interrupt handler. Queued
+ * data is organised as whole commands so that a command from one queue
+ * is never split by bytes from the other. Commands in the urgent queue are
+ * sent before any waiting in the bulk queue (but never interrupt a
+ * command part way through). Interrupts must be enabled globally for
+ * queued data to be sent.
  */ 
 
 #ifndef SPI_H_
 #define SPI_H_
 
+#include <stdint.h>
+
+// Queues that commands can be added to
+#define SPI_QUEUE_BULK		0
+#define SPI_QUEUE_URGENT	1
+
 // Set up SPI communication as a master.
-// clockdivider should be one of 2,4,8,16,32,64,128
+// clockdivider should be one of 2,4,8,16,32,64,128 (or, if SPI_USE_USART1
+// is defined, any even number up to 254)
 void spi_setup_master(uint8_t clockdivider);
 
+// Leave at least the given number of microseconds between queued commands
+// (0, the default, for no gap). This gives a slow receiver time to deal
+// with each command. Timer/counter 2 is used to time the gap, and an 8MHz
+// clock is assumed.
+void spi_set_command_gap(uint8_t microseconds);
+
 // Send and receive an SPI byte. This function will take at least 8 
-// cyles of the divided clock (i.e. will busy wait).
+// cyles of the divided clock (i.e. will busy wait). Any queued data is
+// sent first.
 uint8_t spi_send_byte(uint8_t byte);
 
-#endif /* SPI_H_ */
\ No newline at end of file
+// Start a command of the given length (1 to 255 bytes) in the given queue.
+// Returns 1 if there is room for it, in which case exactly length calls to
+// spi_queue_byte() followed by spi_queue_end() must follow. Returns 0 if
+// the queue does not have room (and nothing else should be done).
+uint8_t spi_queue_begin(uint8_t queue, uint8_t length);
+void spi_queue_byte(uint8_t byte);
+void spi_queue_end(void);
+
+// Return the length of the longest command that the given queue currently
+// has room for
+uint8_t spi_queue_space(uint8_t queue);
+
+// Return 1 if nothing from the given queue is waiting or being sent
+uint8_t spi_queue_is_idle(uint8_t queue);
+
+// Return the number of times spi_queue_begin() has found a queue full
+uint16_t spi_queue_full_count(void);
+
+#endif /* SPI_H_ */
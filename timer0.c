@@ -3,9 +3,9 @@
  *
  * Author: Peter Sutton
  *
- * We setup timer0 to generate an interrupt every 1ms
- * We update a global clock tick variable - whose value
- * can be retrieved using the get_clock_ticks() function.
+ * We setup timer0 to generate an interrupt every 1ms, which
+ * refreshes the seven segment display. (Time is kept by timer 1 -
+ * see timer1.h.)
  */
 
 #include <avr/io.h>
@@ -15,11 +15,6 @@
 #include "timer0.h"
 #include "player.h"
 
-
-/* Our internal clock tick count - incremented every 
- * millisecond. Will overflow every ~49 days. */
-static volatile uint32_t clockTicks;
-
 // Double speed mode (Odd = Off, Even = On)
 uint32_t double_speed = 1;
 
@@ -32,11 +27,6 @@ uint32_t double_speed = 1;
  * output compare value.
  */
 void init_timer0(void) {
-	/* Reset clock tick count. L indicates a long (32 bit) 
-	 * constant. 
-	 */
-	clockTicks = 0L;
-	
 	/* Clear the timer */
 	TCNT0 = 0;
 
@@ -62,23 +52,6 @@ void init_timer0(void) {
 	TIFR0 |= (1<<OCF0A);
 }
 
-uint32_t get_current_time(void) {
-	uint32_t returnValue;
-
-	/* Disable interrupts so we can be sure that the interrupt
-	 * doesn't fire when we've copied just a couple of bytes
-	 * of the value. Interrupts are re-enabled if they were
-	 * enabled at the start.
-	 */
-	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
-	cli();
-	returnValue = clockTicks;
-	if(interruptsOn) {
-		sei();
-	}
-	return returnValue;
-}
-
 void increment_double_speed(void) {
 	double_speed++;
 }
@@ -100,9 +73,6 @@ uint8_t seven_seg[10] = {63, 6, 91, 79, 102, 109, 125, 7, 127, 111}; // 0-9
 volatile uint8_t seven_seg_cc = 0; // left  = 1 right = 0;
 
 ISR(TIMER0_COMPA_vect) {
-	/* Increment our clock tick count */
-	clockTicks++;
-	
 	// switch between left and right display
 	seven_seg_cc = 1 ^ seven_seg_cc;	
 	
@@ -4,15 +4,16 @@
  * Author: Peter Sutton
  *
  * We set up timer 0 to give us an interrupt
- * every millisecond. Tasks that have to occur
- * regularly (every millisecond or few) can be added 
- * to the interrupt handler (in timer0.c) or can
- * be added to the main event loop that checks the
- * clock tick value. This value (32 bits) can be 
- * obtained using the get_clock_ticks() function.
- * (Any tasks undertaken in the interrupt handler
- * should be kept short so that we don't run the 
- * risk of missing an interrupt in future.)
+ * every millisecond, which refreshes the seven
+ * segment display (one digit at a time) at a fixed
+ * rate. Its compare match also starts the joystick's
+ * ADC conversions (see joystick.h). Nothing else
+ * depends on this interrupt - time is kept by timer 1
+ * (see timer1.h), which only interrupts when
+ * something is due. (Any tasks undertaken in the
+ * interrupt handler should be kept short so that we
+ * don't run the risk of missing an interrupt in
+ * future.)
  */
 
 #ifndef TIMER0_H_
@@ -21,15 +22,10 @@
 #include <stdint.h>
 
 /* Set up our timer to give us an interrupt every millisecond
- * and update our time reference.
+ * for the seven segment display.
  */
 void init_timer0(void);
 
-/* Return the current clock tick value - milliseconds since the timer was
- * initialised.
- */
-uint32_t get_current_time(void);
-
 // Add 1 to double speed
 void increment_double_speed(void);
 uint32_t get_double_speed(void);
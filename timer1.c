@@ -0,0 +1,134 @@
+/*
+ * timer1.c
+ *
+ * We divide the clock by 64 and timer 1 counts from 0 to 62499 and back
+ * to 0 (CTC mode) - i.e. 62500 counts of 8 microseconds, or half a second,
+ * with an 8MHz clock. The compare match A interrupt at the end of each
+ * half second counts the half seconds. Compare match B is moved to
+ * whenever the next wake up is wanted - its interrupt handler does
+ * nothing but wake the CPU.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+
+#include "timer1.h"
+
+#define MS_PER_PERIOD		500
+#define COUNTS_PER_PERIOD	((uint16_t)MS_PER_PERIOD * TIMER1_COUNTS_PER_MS)
+
+/* Number of complete half seconds since the timer was initialised */
+static volatile uint32_t periods;
+
+static void read_timer(uint32_t* periods_now, uint16_t* count_now);
+
+///////////////////////// PUBLIC FUNCTIONS //////////////////////////////////
+
+void init_timer1(void) {
+	periods = 0;
+
+	/* Clear the timer, and set the top of the count */
+	TCNT1 = 0;
+	OCR1A = COUNTS_PER_PERIOD - 1;
+
+	/* Set the timer to clear on compare match with OCR1A (CTC mode)
+	 * and to divide the clock by 64. This starts the timer running.
+	 */
+	TCCR1A = 0;
+	TCCR1B = (1<<WGM12)|(1<<CS11)|(1<<CS10);
+
+	/* Interrupt at the end of each half second only (until a wake up time
+	 * is set). Make sure the interrupt flags are cleared by writing 1s to
+	 * them.
+	 */
+	TIFR1 = (1<<OCF1A)|(1<<OCF1B);
+	TIMSK1 = (1<<OCIE1A);
+}
+
+uint32_t get_current_time(void) {
+	uint32_t periods_now;
+	uint16_t count_now;
+	read_timer(&periods_now, &count_now);
+	return periods_now * MS_PER_PERIOD + count_now / TIMER1_COUNTS_PER_MS;
+}
+
+uint32_t get_current_counts(void) {
+	uint32_t periods_now;
+	uint16_t count_now;
+	read_timer(&periods_now, &count_now);
+	return periods_now * COUNTS_PER_PERIOD + count_now;
+}
+
+void set_wakeup_time(uint32_t time) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+
+	uint32_t periods_now;
+	uint16_t count_now;
+	read_timer(&periods_now, &count_now);
+
+	/* (The subtraction copes with the time wrapping around) */
+	int32_t ms_into_period = time - periods_now * MS_PER_PERIOD;
+	if(ms_into_period >= MS_PER_PERIOD) {
+		/* Not this half second - the end of period interrupt will do */
+		TIMSK1 &= ~(1<<OCIE1B);
+	} else {
+		/* Compare match B happens when the count reaches OCR1B. If that
+		 * has already gone by we use the count after next instead (which
+		 * is soon enough). At the very end of the half second we don't
+		 * need it at all.
+		 */
+		uint16_t match = 0;
+		if(ms_into_period > 0) {
+			match = ms_into_period * TIMER1_COUNTS_PER_MS;
+		}
+		if(match <= count_now + 1) {
+			match = count_now + 2;
+		}
+		if(match < COUNTS_PER_PERIOD) {
+			OCR1B = match;
+			TIFR1 = (1<<OCF1B);
+			TIMSK1 |= (1<<OCIE1B);
+		} else {
+			TIMSK1 &= ~(1<<OCIE1B);
+		}
+	}
+
+	if(interruptsOn) {
+		sei();
+	}
+}
+
+///////////////////// STATIC FUNCTIONS /////////////////////////////////////
+
+/* Read the half second count and the timer together. If the timer has
+ * cleared at the end of a half second but the interrupt hasn't run yet
+ * (because interrupts are off) the half second count is one behind. (The
+ * flag is set a count before the timer clears, so a count near the top
+ * means it hasn't cleared yet.)
+ */
+static void read_timer(uint32_t* periods_now, uint16_t* count_now) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	*periods_now = periods;
+	*count_now = TCNT1;
+	if((TIFR1 & (1<<OCF1A)) && *count_now < COUNTS_PER_PERIOD / 2) {
+		(*periods_now)++;
+	}
+	if(interruptsOn) {
+		sei();
+	}
+}
+
+/* Interrupt handler for the end of each half second */
+ISR(TIMER1_COMPA_vect) {
+	periods++;
+}
+
+/* Interrupt handler for a wake up time. Waking the CPU is all that's
+ * needed - the interrupt is turned off until another time is set.
+ */
+ISR(TIMER1_COMPB_vect) {
+	TIMSK1 &= ~(1<<OCIE1B);
+}
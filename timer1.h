@@ -0,0 +1,44 @@
+/*
+ * timer1.h
+ *
+ * Timer 1 keeps the time without a regular interrupt. It counts
+ * continuously (in 8 microsecond counts) and only interrupts at the end of
+ * each half second, so the time is read from the counter itself. Rather
+ * than checking the time every millisecond, code that has something due
+ * later asks to be woken up then (see set_wakeup_time()) - its compare
+ * match interrupt wakes the CPU from idle sleep at that time.
+ */
+
+#ifndef TIMER1_H_
+#define TIMER1_H_
+
+#include <stdint.h>
+
+/* Timer counts per millisecond. Each count is 8 microseconds. */
+#define TIMER1_COUNTS_PER_MS 125
+
+/* Set up timer 1 and start the time from 0.
+ */
+void init_timer1(void);
+
+/* Return the current time - milliseconds since the timer was initialised.
+ * Wraps around every 49 days.
+ */
+uint32_t get_current_time(void);
+
+/* Return the time since the timer was initialised in timer counts (see
+ * above) - for measuring short times more finely than get_current_time().
+ * Wraps around every 9.5 hours.
+ */
+uint32_t get_current_counts(void);
+
+/* Make sure an interrupt happens at (or just after) the given time (from
+ * get_current_time()), e.g. to wake the CPU when something falls due. If
+ * the time is after the end of the current half second, the interrupt at
+ * the end of the half second happens first and this should be called
+ * again after it. Only one wake up time is kept - each call replaces the
+ * last. Times already passed cause an interrupt straight away.
+ */
+void set_wakeup_time(uint32_t time);
+
+#endif /* TIMER1_H_ */
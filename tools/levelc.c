@@ -0,0 +1,260 @@
+/*
+ * levelc.c
+ *
+ * Host program (not built for the AVR) which compiles the level designs
+ * in levels/ into level_pack.c and level_pack.h (see level_design.h). Build
+ * and run it from the project directory whenever a level changes (e.g. as
+ * a pre-build step), giving the levels in the order they are played:
+ *     gcc -o levelc tools/levelc.c
+ *     ./levelc level_pack.c level_pack.h levels/[0-9]*.txt
+ *
+ * Each level file contains these lines (blank lines and lines starting
+ * with # are ignored):
+ *     colour <name>				- green, light_green, red, yellow,
+ *								  light_yellow, orange or light_orange
+ *     alien_move_ms <ms>		- time between alien moves at normal speed
+ *     alien_add_ms <ms>		- time between attempts to add an alien
+ * followed by either
+ *     generate <seed> <style>...	- a generated background, with any of
+ *								  floor, ceiling and obstacles
+ * or
+ *     terrain
+ * and then 8 lines giving the background, top row (row 7) first - one
+ * character per column, # for background and . for empty space. Designed
+ * backgrounds repeat once they have all scrolled past. The player starts
+ * on row 4 in columns 0 and 1, so these must be empty.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define NUM_ROWS		8
+#define MAX_LINE		1024
+#define MAX_COLUMNS		(MAX_LINE - 2)
+#define PLAYER_ROW		4
+
+static const char* const colour_names[][2] = {
+	{ "green", "COLOUR_GREEN" },
+	{ "light_green", "COLOUR_LIGHT_GREEN" },
+	{ "red", "COLOUR_RED" },
+	{ "yellow", "COLOUR_YELLOW" },
+	{ "light_yellow", "COLOUR_LIGHT_YELLOW" },
+	{ "orange", "COLOUR_ORANGE" },
+	{ "light_orange", "COLOUR_LIGHT_ORANGE" }
+};
+#define NUM_COLOURS (sizeof(colour_names) / sizeof(colour_names[0]))
+
+static const char* const style_names[][2] = {
+	{ "floor", "BACKGROUND_STYLE_FLOOR" },
+	{ "ceiling", "BACKGROUND_STYLE_CEILING" },
+	{ "obstacles", "BACKGROUND_STYLE_OBSTACLES" }
+};
+#define NUM_STYLES (sizeof(style_names) / sizeof(style_names[0]))
+
+// A level as read from its file
+typedef struct {
+	const char* colour;
+	unsigned alien_move_ms;
+	unsigned alien_add_ms;
+	int generated;
+	unsigned seed;
+	char style[128];
+	int num_columns;
+	uint8_t columns[MAX_COLUMNS];
+} Level;
+
+static const char* file_name;
+static int line_number;
+
+static void fail(const char* message) {
+	fprintf(stderr, "%s:%d: %s\n", file_name, line_number, message);
+	exit(1);
+}
+
+// Read the next line that isn't blank (or a comment, unless comments are
+// not allowed - terrain rows may start with #), without its line ending.
+// Returns 0 at the end of the file.
+static int read_line(FILE* in, char* line, int allow_comments) {
+	while(fgets(line, MAX_LINE, in)) {
+		line_number++;
+		line[strcspn(line, "\r\n")] = 0;
+		if(line[0] != 0 && !(allow_comments && line[0] == '#')) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static const char* look_up(const char* const names[][2], int count, const char* name) {
+	for(int i = 0; i < count; i++) {
+		if(strcmp(names[i][0], name) == 0) {
+			return names[i][1];
+		}
+	}
+	return 0;
+}
+
+static void read_terrain(FILE* in, Level* level) {
+	char line[MAX_LINE];
+	level->num_columns = -1;
+	memset(level->columns, 0, sizeof(level->columns));
+	for(int row = NUM_ROWS - 1; row >= 0; row--) {
+		if(!read_line(in, line, 0)) {
+			fail("expected 8 rows of terrain");
+		}
+		int width = strlen(line);
+		if(width == 0 || width > MAX_COLUMNS || 
+				(level->num_columns != -1 && width != level->num_columns)) {
+			fail("terrain rows must all be the same length");
+		}
+		level->num_columns = width;
+		for(int x = 0; x < width; x++) {
+			if(line[x] == '#') {
+				level->columns[x] |= (1 << row);
+			} else if(line[x] != '.') {
+				fail("terrain may only contain # and .");
+			}
+		}
+	}
+	if(level->num_columns < 2 || 
+			((level->columns[0] | level->columns[1]) & (1 << PLAYER_ROW))) {
+		fail("the player's starting position (row 4, columns 0 and 1) must be empty");
+	}
+}
+
+static void read_level(Level* level) {
+	FILE* in = fopen(file_name, "r");
+	if(!in) {
+		perror(file_name);
+		exit(1);
+	}
+	memset(level, 0, sizeof(*level));
+	line_number = 0;
+	char line[MAX_LINE];
+	int have_background = 0;
+	while(read_line(in, line, 1)) {
+		char word[64];
+		char value[MAX_LINE];
+		int n = sscanf(line, "%63s %1000[^\n]", word, value);
+		if(strcmp(word, "colour") == 0 && n == 2) {
+			level->colour = look_up(colour_names, NUM_COLOURS, value);
+			if(!level->colour) {
+				fail("unknown colour");
+			}
+		} else if(strcmp(word, "alien_move_ms") == 0 && n == 2) {
+			level->alien_move_ms = strtoul(value, 0, 0);
+		} else if(strcmp(word, "alien_add_ms") == 0 && n == 2) {
+			level->alien_add_ms = strtoul(value, 0, 0);
+		} else if(strcmp(word, "generate") == 0 && n == 2) {
+			char* style = strtok(value, " \t");
+			level->seed = strtoul(style, 0, 0);
+			level->generated = 1;
+			strcpy(level->style, "0");
+			while((style = strtok(0, " \t"))) {
+				const char* style_macro = look_up(style_names, NUM_STYLES, style);
+				if(!style_macro) {
+					fail("unknown background style");
+				}
+				strcat(level->style, " | ");
+				strcat(level->style, style_macro);
+			}
+			have_background = 1;
+		} else if(strcmp(word, "terrain") == 0 && n == 1) {
+			read_terrain(in, level);
+			have_background = 1;
+		} else {
+			fail("unrecognised line");
+		}
+	}
+	fclose(in);
+	if(!level->colour || !level->alien_move_ms || !level->alien_add_ms || 
+			!have_background) {
+		fail("colour, alien_move_ms, alien_add_ms and a background must all be given");
+	}
+	if(level->alien_move_ms > 65535 || level->alien_add_ms > 65535 || level->seed > 65535) {
+		fail("times and seeds must fit in 16 bits");
+	}
+}
+
+// Write the run length coded terrain for the given level. Returns the
+// number of bytes written.
+static int write_terrain(FILE* out, int level_number, const Level* level) {
+	int bytes = 0;
+	fprintf(out, "static const uint8_t terrain_%d[] PROGMEM = {", level_number);
+	for(int x = 0; x < level->num_columns; ) {
+		int count = 1;
+		while(x + count < level->num_columns && count < 255 &&
+				level->columns[x + count] == level->columns[x]) {
+			count++;
+		}
+		fprintf(out, "%s%d, 0x%02X,", (bytes % 12) ? " " : "\n\t\t", count, level->columns[x]);
+		bytes += 2;
+		x += count;
+	}
+	fprintf(out, "\n\t\t0 };\n");
+	return bytes + 1;
+}
+
+int main(int argc, char** argv) {
+	if(argc < 4) {
+		fprintf(stderr, "Usage: %s output.c output.h level.txt...\n", argv[0]);
+		return 1;
+	}
+	int num_levels = argc - 3;
+	Level* levels = calloc(num_levels, sizeof(Level));
+	for(int i = 0; i < num_levels; i++) {
+		file_name = argv[i + 3];
+		read_level(&levels[i]);
+	}
+	
+	FILE* out_c = fopen(argv[1], "w");
+	FILE* out_h = fopen(argv[2], "w");
+	if(!out_c || !out_h) {
+		perror("levelc");
+		return 1;
+	}
+	const char* banner = 
+			" *\n"
+			" * GENERATED by tools/levelc.c from the level designs in levels/\n"
+			" * - do not edit. See level_design.h for the format.\n"
+			" */\n\n";
+	fprintf(out_h, "/*\n * level_pack.h\n%s", banner);
+	fprintf(out_h, "#ifndef LEVEL_PACK_H_\n#define LEVEL_PACK_H_\n\n"
+			"#include \"level_design.h\"\n\n"
+			"#define NUM_LEVEL_DESIGNS %d\n\n"
+			"// Level designs (in program memory) in the order they are played\n"
+			"extern const LevelDesign level_designs[NUM_LEVEL_DESIGNS];\n\n"
+			"#endif /* LEVEL_PACK_H_ */\n", num_levels);
+	
+	fprintf(out_c, "/*\n * level_pack.c\n%s", banner);
+	fprintf(out_c, "#include <avr/pgmspace.h>\n#include \"level_pack.h\"\n\n");
+	int total_bytes = 0;
+	for(int i = 0; i < num_levels; i++) {
+		if(!levels[i].generated) {
+			fprintf(out_c, "// %s\n", argv[i + 3]);
+			total_bytes += write_terrain(out_c, i, &levels[i]);
+			fprintf(out_c, "\n");
+		}
+	}
+	fprintf(out_c, "const LevelDesign level_designs[NUM_LEVEL_DESIGNS] PROGMEM = {\n");
+	for(int i = 0; i < num_levels; i++) {
+		const Level* level = &levels[i];
+		char terrain[32] = "0";
+		if(!level->generated) {
+			sprintf(terrain, "terrain_%d", i);
+		}
+		fprintf(out_c, "\t{ %s, 0x%04X, %s, %s, %u, %u }%s\t// %s\n", terrain,
+				level->seed, level->generated ? level->style : "0", level->colour, 
+				level->alien_move_ms, level->alien_add_ms, 
+				(i < num_levels - 1) ? "," : "", argv[i + 3]);
+		total_bytes += sizeof(uint16_t) * 4 + 4;
+	}
+	fprintf(out_c, "};\n");
+	
+	fclose(out_c);
+	fclose(out_h);
+	printf("%d levels, %d bytes of program memory\n", num_levels, total_bytes);
+	return 0;
+}
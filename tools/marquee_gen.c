@@ -0,0 +1,178 @@
+/*
+ * marquee_gen.c
+ *
+ * Host program (not built for the AVR) which turns the messages listed in
+ * marquee_messages.txt into the column data scroll_display() shows, so
+ * that nothing has to be decoded on the microcontroller. Build and run it
+ * from the project directory whenever the messages change (e.g. as a
+ * pre-build step):
+ *     gcc -o marquee_gen tools/marquee_gen.c
+ *     ./marquee_gen tools/marquee_messages.txt marquee_data.c marquee_data.h
+ *
+ * Each message becomes an array of column bytes in program memory. Bits 7
+ * to 1 of each byte are rows 7 to 1 of the column (row 0 is always blank).
+ * Bit 0 is set only in the last column of the message.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+
+/* FONT DEFINITION
+ *
+ * Columns of each character (A-Z and 0-9), as formerly used at run time
+ * by scrolling_char_display.c. The most significant 7 bits are rows 7 to
+ * 1 of the column. The least significant bit is 1 only for the last
+ * column of the character. Lower case letters are shown as upper case.
+ * Any other character is shown as a blank column.
+ */
+static const uint8_t cols_A[] = {126, 144, 144, 127};
+static const uint8_t cols_B[] = {254, 146, 146, 109};
+static const uint8_t cols_C[] = {124, 130, 130, 69};
+static const uint8_t cols_D[] = {254, 130, 130, 125};
+static const uint8_t cols_E[] = {254, 146, 146, 131};
+static const uint8_t cols_F[] = {254, 144, 144, 129};
+static const uint8_t cols_G[] = {124, 130, 146, 93};
+static const uint8_t cols_H[] = {254, 16, 16, 255};
+static const uint8_t cols_I[] = {130, 254, 131};
+static const uint8_t cols_J[] = {4, 2, 2, 253};
+static const uint8_t cols_K[] = {254, 16, 40, 199};
+static const uint8_t cols_L[] = {254, 2, 2, 3};
+static const uint8_t cols_M[] = {254, 64, 48, 64, 255};
+static const uint8_t cols_N[] = {254, 32, 16, 255};
+static const uint8_t cols_O[] = {124, 130, 130, 125};
+static const uint8_t cols_P[] = {254, 144, 144, 97};
+static const uint8_t cols_Q[] = {124, 130, 138, 124, 3};
+static const uint8_t cols_R[] = {254, 144, 152, 103};
+static const uint8_t cols_S[] = {100, 146, 146, 77};
+static const uint8_t cols_T[] = {128, 128, 254, 128, 129};
+static const uint8_t cols_U[] = {252, 2, 2, 253};
+static const uint8_t cols_V[] = {248, 4, 2, 4, 249};
+static const uint8_t cols_W[] = {252, 2, 28, 2, 253};
+static const uint8_t cols_X[] = {198, 40, 16, 40, 199};
+static const uint8_t cols_Y[] = {224, 16, 14, 16, 225};
+static const uint8_t cols_Z[] = {134, 138, 146, 162, 195};
+
+static const uint8_t cols_0[] = {124, 146, 162, 125};
+static const uint8_t cols_1[] = {66, 254, 3};
+static const uint8_t cols_2[] = {70, 138, 146, 99};
+static const uint8_t cols_3[] = {68, 146, 146, 109};
+static const uint8_t cols_4[] = {24, 40, 72, 255};
+static const uint8_t cols_5[] = {228, 162, 162, 157};
+static const uint8_t cols_6[] = {124, 146, 146, 77};
+static const uint8_t cols_7[] = {128, 158, 160, 193};
+static const uint8_t cols_8[] = {108, 146, 146, 109};
+static const uint8_t cols_9[] = {100, 146, 146, 125};
+
+static const uint8_t* const letters[26] = {
+		cols_A, cols_B, cols_C, cols_D, cols_E, cols_F,
+		cols_G, cols_H, cols_I, cols_J, cols_K, cols_L,
+		cols_M, cols_N, cols_O, cols_P, cols_Q, cols_R, 
+		cols_S, cols_T, cols_U, cols_V, cols_W, cols_X,
+		cols_Y, cols_Z };
+		
+static const uint8_t* const numbers[10] = {
+		cols_0, cols_1, cols_2, cols_3, cols_4, 
+		cols_5, cols_6, cols_7, cols_8, cols_9 };
+
+#define MAX_LINE 256
+#define MAX_COLUMNS (MAX_LINE * 6 + 2)
+
+// Return the font data for the given character, or 0 if it is shown as
+// a blank column
+static const uint8_t* glyph_for(char c) {
+	if(c >= 'a' && c <= 'z') {
+		return letters[c - 'a'];
+	} else if(c >= 'A' && c <= 'Z') {
+		return letters[c - 'A'];
+	} else if(c >= '0' && c <= '9') {
+		return numbers[c - '0'];
+	}
+	return 0;
+}
+
+// Work out the columns for the given text - the same columns the run time
+// decoder used to produce: a blank column to start, then for each
+// character a blank column followed by its columns, then a blank column
+// for the end of the string. Returns the number of columns.
+static int build_columns(const char* text, uint8_t* columns) {
+	int n = 0;
+	columns[n++] = 0;
+	for(const char* c = text; *c; c++) {
+		columns[n++] = 0;
+		const uint8_t* glyph = glyph_for(*c);
+		if(glyph) {
+			int last;
+			do {
+				last = *glyph & 1;
+				columns[n++] = *(glyph++) & 0xFE;
+			} while(!last);
+		}
+	}
+	columns[n++] = 0;
+	columns[n - 1] |= 1;	// mark the end of the message
+	return n;
+}
+
+int main(int argc, char** argv) {
+	if(argc != 4) {
+		fprintf(stderr, "Usage: %s messages.txt output.c output.h\n", argv[0]);
+		return 1;
+	}
+	FILE* in = fopen(argv[1], "r");
+	FILE* out_c = fopen(argv[2], "w");
+	FILE* out_h = fopen(argv[3], "w");
+	if(!in || !out_c || !out_h) {
+		perror("marquee_gen");
+		return 1;
+	}
+	
+	const char* banner = 
+			" *\n"
+			" * GENERATED by tools/marquee_gen.c from tools/marquee_messages.txt\n"
+			" * - do not edit. Column data for the scrolling messages (see\n"
+			" * scrolling_char_display.h).\n"
+			" */\n\n";
+	fprintf(out_c, "/*\n * %s\n%s", "marquee_data.c", banner);
+	fprintf(out_c, "#include <avr/pgmspace.h>\n#include \"marquee_data.h\"\n");
+	fprintf(out_h, "/*\n * %s\n%s", "marquee_data.h", banner);
+	fprintf(out_h, "#ifndef MARQUEE_DATA_H_\n#define MARQUEE_DATA_H_\n\n"
+			"#include <stdint.h>\n\n");
+	
+	char line[MAX_LINE];
+	uint8_t columns[MAX_COLUMNS];
+	int line_number = 0;
+	while(fgets(line, sizeof(line), in)) {
+		line_number++;
+		line[strcspn(line, "\r\n")] = 0;
+		if(line[0] == '#' || line[0] == 0) {
+			continue;
+		}
+		char* text = strchr(line, ' ');
+		if(!text) {
+			fprintf(stderr, "%s:%d: expected a name and text\n", argv[1], line_number);
+			return 1;
+		}
+		*(text++) = 0;
+		for(char* c = line; *c; c++) {
+			*c = toupper((unsigned char)*c);
+		}
+		
+		int n = build_columns(text, columns);
+		fprintf(out_c, "\n// %s\nconst uint8_t MARQUEE_%s[%d] PROGMEM = {", text, line, n);
+		for(int i = 0; i < n; i++) {
+			fprintf(out_c, "%s%d%s", (i % 12) ? " " : "\n\t\t", columns[i], 
+					(i < n - 1) ? "," : "");
+		}
+		fprintf(out_c, " };\n");
+		fprintf(out_h, "extern const uint8_t MARQUEE_%s[%d];\n", line, n);
+	}
+	fprintf(out_h, "\n#endif /* MARQUEE_DATA_H_ */\n");
+	
+	fclose(in);
+	fclose(out_c);
+	fclose(out_h);
+	return 0;
+}